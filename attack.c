@@ -54,9 +54,10 @@ void bombard_city(piece_info_t *att_obj, loc_t loc) {
 		}
 	} else {
 		/* Neutralize the city */
-		cityp->owner = UNOWNED;
+		set_city_owner(cityp, UNOWNED);
 		cityp->prod = NOPIECE;
 		cityp->work = 0;
+		vmap_changed(cityp->loc);
 		
 		if (IS_ATTACKER_HUMAN(att_owner)) {
 			comment("Your battleship has neutralized the city!");
@@ -108,7 +109,8 @@ void attack_city(piece_info_t *att_obj, loc_t loc) {
 		kill_obj(att_obj, loc);
 	} else { /* attack succeeded */
 		kill_city(cityp);
-		cityp->owner = att_owner;
+		set_city_owner(cityp, att_owner);
+		vmap_changed(cityp->loc);
 		kill_obj(att_obj, loc);
 
 		if (IS_ATTACKER_HUMAN(att_owner)) {
@@ -18,9 +18,15 @@ For each move the user wants us to make, we do the following:
 
 #include "empire.h"
 #include "extern.h"
+#include <pthread.h>
 #include <string.h>
 
-static view_map_t emap[MAP_SIZE]; /* pruned explore map */
+static view_map_t *emap; /* pruned explore map */
+static path_ctx_t path_ctx;       /* search scratch */
+
+static cont_labels_t land_conts;   /* continents of our view map */
+static cont_labels_t lake_conts;   /* bodies of water in 'emap' */
+static cont_labels_t unload_conts; /* continents of unload maps */
 
 bool load_army(piece_info_t *obj);
 bool lake(loc_t loc);
@@ -29,6 +35,7 @@ bool nearby_load(piece_info_t *obj, loc_t loc);
 count_t nearby_count(loc_t loc);
 void move_objective(piece_info_t *obj, path_map_t pathmap[], loc_t new_loc,
                     char *adj_list);
+void unmark_explore_locs(view_map_t *xmap);
 void comp_set_prod(city_info_t *, int);
 void comp_set_needed(city_info_t *, int *, bool, bool);
 void comp_prod(city_info_t *, bool);
@@ -39,19 +46,19 @@ loc_t find_attack(loc_t, char *, char *);
 AI city production for AI-controlled human players
 */
 void ai_city_production(int owner) {
-	int i;
+	city_set_t *cs = &game.owned[owner];
+	int i, k;
 	
-	for (i = 0; i < NUM_CITY; i++) {
-		if (game.city[i].owner == owner) {
-			/* If no production set, default to ARMY */
-			if (game.city[i].prod == NOPIECE) {
-				game.city[i].prod = ARMY;
-				game.city[i].work = 0;
-			}
-			/* Produce if ready */
-			if (game.city[i].work++ >= (long)piece_attr[(int)game.city[i].prod].build_time) {
-				produce(&game.city[i]);
-			}
+	for (k = 0; k < cs->count; k++) {
+		i = cs->index[k];
+		/* If no production set, default to ARMY */
+		if (game.city[i].prod == NOPIECE) {
+			game.city[i].prod = ARMY;
+			game.city[i].work = 0;
+		}
+		/* Produce if ready */
+		if (game.city[i].work++ >= (long)piece_attr[(int)game.city[i].prod].build_time) {
+			produce(&game.city[i]);
 		}
 	}
 }
@@ -62,24 +69,19 @@ AI movement for AI-controlled human players
 void ai_player_move(int owner) {
 	int i;
 	piece_info_t *obj;
-	view_map_t *player_map = MAP(owner);
+	piece_info_t **list = LIST(owner);
 	
-	/* Update player's view of the world */
 	for (i = 0; i < NUM_OBJECTS; i++) {
-		for (obj = game.user_obj[i]; obj != NULL;
-		     obj = obj->piece_link.next) {
-			if (obj->owner == owner) {
-				obj->moved = 0;
-				scan(player_map, obj->loc);
-			}
+		for (obj = list[i]; obj != NULL; obj = NEXT(obj, piece_link)) {
+			obj->moved = 0;
 		}
 	}
 	
 	/* Move all pieces for this player */
 	for (i = 0; i < NUM_OBJECTS; i++) {
-		for (obj = game.user_obj[move_order[i]]; obj != NULL;
-		     obj = obj->piece_link.next) {
-			if (obj->owner == owner && !obj->moved) {
+		for (obj = list[move_order[i]]; obj != NULL;
+		     obj = NEXT(obj, piece_link)) {
+			if (!obj->moved) {
 				/* Set default function for armies */
 				if ((obj->type == ARMY || obj->type == MARINE) && obj->func == NOFUNC) {
 					obj->func = ARMYATTACK;
@@ -93,26 +95,78 @@ void ai_player_move(int owner) {
 	(void)redisplay();
 }
 
+/*
+Bring 'emap' up to date with our view map.  The predictions made by
+'vmap_prune_explore_locs' depend only on which cells we have explored.
+So we copy over just the cells whose contents have changed, and when
+we explore cells we had predicted we make the predictions again only
+around them (see 'vmap_prune_explore_near').  The whole map is pruned
+only when we lose track of what changed.
+*/
+
+static bool *emap_guess; /* cell of 'emap' is a prediction */
+static unsigned long emap_clock;  /* change clock when 'emap' was made */
+static long emap_gen;             /* times 'emap' has been made */
+static long emap_blank;           /* unexplored cells left in 'emap' */
+
+static void update_emap(void) {
+	perimeter_t *changes = &path_ctx.perim[0];
+	perimeter_t *fresh = &path_ctx.perim[2];
+	loc_t loc;
+	long i;
+
+	if (emap_gen > 0 && vmap_changes(emap_clock, changes)) {
+		fresh->len = 0;
+		for (i = 0; i < changes->len; i++) {
+			loc = changes->list[i];
+			if (!emap_guess[loc]) {
+				emap[loc] = game.comp_map[loc];
+			} else if (game.comp_map[loc].contents != ' ') {
+				if (emap[loc].contents == ' ') {
+					emap_blank -= 1;
+				}
+				emap[loc] = game.comp_map[loc];
+				emap_guess[loc] = false; /* newly explored */
+				fresh->list[fresh->len++] = loc;
+			}
+		}
+		if (fresh->len > 0) {
+			emap_blank = vmap_prune_explore_near(
+			    &path_ctx, emap, emap_guess, fresh, emap_blank);
+		}
+		/* predictions that changed are on the list now too */
+		if (vmap_changes(emap_clock, changes)) {
+			vmap_cont_recheck(&lake_conts, changes);
+		} else {
+			vmap_cont_refresh(&lake_conts);
+		}
+		emap_clock = vmap_change_clock();
+		return;
+	}
+	(void)memcpy(emap, game.comp_map, MAP_SIZE * sizeof(view_map_t));
+	for (loc = 0; loc < MAP_SIZE; loc++) {
+		emap_guess[loc] = (emap[loc].contents == ' ');
+	}
+	emap_blank = vmap_prune_explore_locs(&path_ctx, emap);
+	emap_clock = vmap_change_clock();
+	emap_gen += 1;
+
+	vmap_cont_refresh(&lake_conts);
+	vmap_cont_forget(&unload_conts);
+}
+
 void comp_move(int nmoves) {
 	void do_cities(void), do_pieces(void), check_endgame(void);
 
 	int i;
-	piece_info_t *obj;
 
-	/* Update our view of the world. */
-
-	for (i = 0; i < NUM_OBJECTS; i++)
-		for (obj = game.comp_obj[i]; obj != NULL;
-		     obj = obj->piece_link.next)
-			scan(game.comp_map,
-			     obj->loc); /* refresh comp's view of world */
+	/* Our view of the world is kept up to date as it changes; see
+	   'watch_piece'. */
 
 	for (i = 1; i <= nmoves; i++) { /* for each move we get... */
 		comment("Thinking...");
 
-		(void)memcpy(emap, game.comp_map,
-		             MAP_SIZE * sizeof(view_map_t));
-		vmap_prune_explore_locs(emap);
+		update_emap();
 
 		do_cities(); /* handle city production */
 		do_pieces(); /* move pieces */
@@ -142,31 +196,29 @@ build carriers, as we don't have a good strategy for moving these.
 */
 
 void do_cities(void) {
-	int i;
+	city_set_t *cs = &game.owned[COMP];
+	int i, k;
 	bool is_lake;
 
-	for (i = 0; i < NUM_CITY; i++) /* new production */
-		if (game.city[i].owner == COMP) {
-			scan(game.comp_map, game.city[i].loc);
+	for (k = 0; k < cs->count; k++) { /* new production */
+		i = cs->index[k];
 
-			if (game.city[i].prod == NOPIECE)
-				comp_prod(&game.city[i],
-				          lake(game.city[i].loc));
-		}
-	for (i = 0; i < NUM_CITY; i++) /* produce and change */
-		if (game.city[i].owner == COMP) {
-			is_lake = lake(game.city[i].loc);
-			if (game.city[i].work++ >=
-			    (long)piece_attr[(int)game.city[i].prod]
-			        .build_time) {
-				produce(&game.city[i]);
-				comp_prod(&game.city[i], is_lake);
-			}
-			/* don't produce ships in lakes */
-			else if (game.city[i].prod > FIGHTER &&
-			         game.city[i].prod != SATELLITE && is_lake)
-				comp_prod(&game.city[i], is_lake);
+		if (game.city[i].prod == NOPIECE)
+			comp_prod(&game.city[i], lake(game.city[i].loc));
+	}
+	for (k = 0; k < cs->count; k++) { /* produce and change */
+		i = cs->index[k];
+		is_lake = lake(game.city[i].loc);
+		if (game.city[i].work++ >=
+		    (long)piece_attr[(int)game.city[i].prod].build_time) {
+			produce(&game.city[i]);
+			comp_prod(&game.city[i], is_lake);
 		}
+		/* don't produce ships in lakes */
+		else if (game.city[i].prod > FIGHTER &&
+		         game.city[i].prod != SATELLITE && is_lake)
+			comp_prod(&game.city[i], is_lake);
+	}
 }
 
 /*
@@ -200,9 +252,10 @@ The algorithm below contains three parts:
 
 void comp_prod(city_info_t *cityp, bool is_lake) {
 	int city_count[NUM_OBJECTS]; /* # of cities producing each piece */
-	int cont_map[MAP_SIZE];
+	int cont;
 	int total_cities;
-	count_t i;
+	city_set_t *cs = &game.owned[COMP];
+	count_t i, k;
 	int comp_ac;
 	city_info_t *p;
 	int need_count, interest;
@@ -210,23 +263,22 @@ void comp_prod(city_info_t *cityp, bool is_lake) {
 
 	/* Make sure we have army producers for current continent. */
 
-	/* map out city's continent */
-	vmap_cont(cont_map, game.comp_map, cityp->loc, MAP_SEA);
-
-	/* count items of interest on the continent */
-	counts = vmap_cont_scan(cont_map, game.comp_map);
+	/* count items of interest on the city's continent */
+	counts = *vmap_cont_counts(&land_conts, game.comp_map, cityp->loc,
+	                           MAP_SEA);
+	cont = vmap_cont_id(&land_conts, game.comp_map, cityp->loc, MAP_SEA);
 	comp_ac = 0; /* no army producing computer cities */
 
-	for (i = 0; i < MAP_SIZE; i++)
-		if (cont_map[i]) { /* for each cell of continent */
-			if (game.comp_map[i].contents == 'X') {
-				p = find_city(i);
-				ASSERT(p != NULL && p->owner == COMP);
-				// cppcheck-suppress nullPointerRedundantCheck
-				if (p->prod == ARMY)
-					comp_ac += 1;
-			}
+	for (i = 0; i < NUM_CITY; i++) {
+		p = &game.city[i];
+		if (game.comp_map[p->loc].contents == 'X' &&
+		    vmap_cont_id(&land_conts, game.comp_map, p->loc, MAP_SEA) ==
+		        cont) { /* for each city of continent */
+			ASSERT(p->owner == COMP);
+			if (p->prod == ARMY)
+				comp_ac += 1;
 		}
+	}
 	/* see if anything of interest is on continent */
 	interest = (counts.unexplored || counts.user_cities ||
 	            counts.user_objects[ARMY] || counts.unowned_cities);
@@ -256,12 +308,13 @@ void comp_prod(city_info_t *cityp, bool is_lake) {
 
 	total_cities = 0;
 
-	for (i = 0; i < NUM_CITY; i++)
-		if (game.city[i].owner == COMP &&
-		    game.city[i].prod != NOPIECE) {
+	for (k = 0; k < cs->count; k++) {
+		i = cs->index[k];
+		if (game.city[i].prod != NOPIECE) {
 			city_count[(int)game.city[i].prod] += 1;
 			total_cities += 1;
 		}
+	}
 	if (total_cities <= 10)
 		ratio = ratio1;
 	else if (total_cities <= 20)
@@ -284,14 +337,12 @@ void comp_prod(city_info_t *cityp, bool is_lake) {
 		/* if we have one army producer that is not on a lake, */
 		/* produce armies here instead */
 		if (city_count[ARMY] == 1) {
-			for (i = 0; i < NUM_CITY; i++)
-				if (game.city[i].owner == COMP &&
-				    game.city[i].prod == ARMY)
+			for (k = 0; k < cs->count; k++) {
+				i = cs->index[k];
+				if (game.city[i].prod == ARMY)
 					break;
+			}
 
-			// It's mysterious why the following exclusion is
-			// required... cppcheck-suppress arrayIndexOutOfBounds
-			// cppcheck-suppress arrayIndexOutOfBounds
 			if (!lake(game.city[i].loc)) {
 				comp_set_prod(cityp, ARMY);
 				return;
@@ -416,39 +467,380 @@ unexplored territory will be land or water.  The prediction should
 be helpful, because small bodies of water that enclose unexplored
 territory will appear as solid water.  Big bodies of water should
 have unexplored territory on the edges.
+
+The bodies of water in 'emap' are labelled once and shared by every
+city.  When 'emap' is rebuilt the labels are patched for the cells that
+changed, so they are only made afresh if the water itself has changed
+shape.
 */
 
 bool lake(loc_t loc) {
-	int cont_map[MAP_SIZE];
-	scan_counts_t counts;
+	scan_counts_t *counts;
 
-	vmap_cont(cont_map, emap, loc, MAP_LAND); /* game.real_map lake */
-	counts = vmap_cont_scan(cont_map, emap);
+	counts = vmap_cont_counts(&lake_conts, emap, loc, MAP_LAND);
 
-	return !(counts.unowned_cities || counts.user_cities ||
-	         counts.unexplored);
+	return !(counts->unowned_cities || counts->user_cities ||
+	         counts->unexplored);
 }
 
 /*
 Move all computer pieces.
 */
 
-static view_map_t amap[MAP_SIZE]; /* temp view map */
-static path_map_t path_map[MAP_SIZE];
+
+/*
+Scratch maps.  The maps our pieces search are our view map, perhaps
+with unexplored cells filled in from 'emap', with a few cells marked.
+Rather than copy the whole view map for each piece, we keep each
+scratch map from one piece to the next: we put back the cells marked
+for the last piece and copy over the cells noted as changed since.
+Only the contents of scratch map cells are kept up to date.
+*/
+
+typedef struct {
+	bool filled;              /* unexplored cells come from 'emap' */
+	bool made;                /* true once the map has been copied */
+	unsigned long synced;     /* change clock map is up to date with */
+	long emap_gen;            /* 'emap' the map was filled from */
+	long num_marks;           /* cells marked */
+	loc_t *marks;             /* those cells */
+	view_map_t *map;          /* the map itself */
+} scratch_map_t;
+
+/* for exploring and unloading */
+static scratch_map_t fill_map = {true, false, 0, 0, 0, NULL, NULL};
+/* for loading */
+static scratch_map_t load_map = {false, false, 0, 0, 0, NULL, NULL};
+
+/* Return what a scratch map holds at a cell with nothing marked. */
+
+static view_map_t scratch_cell(scratch_map_t *sm, loc_t loc) {
+	view_map_t cell = game.comp_map[loc];
+
+	if (sm->filled && game.real_map[loc].on_board &&
+	    cell.contents == ' ') {
+		cell.contents = emap[loc].contents;
+	}
+	return cell;
+}
+
+/* Bring a scratch map up to date with nothing marked, and return it. */
+
+static view_map_t *clear_map(scratch_map_t *sm) {
+	perimeter_t *changes = &path_ctx.perim[0];
+	long i;
+
+	if (sm->made && (!sm->filled || sm->emap_gen == emap_gen) &&
+	    vmap_changes(sm->synced, changes)) {
+		for (i = 0; i < sm->num_marks; i++) {
+			sm->map[sm->marks[i]] = scratch_cell(sm, sm->marks[i]);
+		}
+		for (i = 0; i < changes->len; i++) {
+			sm->map[changes->list[i]] =
+			    scratch_cell(sm, changes->list[i]);
+		}
+	} else {
+		(void)memcpy(sm->map, game.comp_map,
+		             MAP_SIZE * sizeof(view_map_t));
+		if (sm->filled) {
+			unmark_explore_locs(sm->map);
+		}
+		sm->made = true;
+		sm->emap_gen = emap_gen;
+	}
+	sm->num_marks = 0;
+	sm->synced = vmap_change_clock();
+	return sm->map;
+}
+
+/* Mark a cell of a scratch map. */
+
+static void mark_map(scratch_map_t *sm, loc_t loc, char contents) {
+	sm->map[loc].contents = contents;
+	if (sm->num_marks < MAP_SIZE) {
+		sm->marks[sm->num_marks++] = loc;
+	} else {
+		sm->made = false; /* copy afresh next time */
+	}
+}
+
+/*
+Planning ahead.
+
+Most of the time spent moving our pieces goes into the search each
+piece makes for an objective.  When 'game.plan_threads' is more than
+one, we look ahead down the piece list and run the first search each
+of the next few pieces will make, spread over a pool of threads.  The
+maps do not change while the plans are made.  The pieces are then
+moved one at a time in the usual order.  When a piece makes a search
+we already planned, we use the plan unless a cell the search looked
+at has changed since (see 'vmap_path_changed'); otherwise we search
+again.  A plan is thus only ever used when it is exactly what the
+search would find, and the game plays out just as it does without
+planning.
+
+Only 'comp_move' plans.  The AI seats moved by 'ai_player_move' go
+through 'piece_move' and search as they go, so '-j' does nothing for
+them.
+
+The threads only ever run the bitboard search behind 'vmap_find_lobj',
+'vmap_find_aobj' and 'vmap_find_wobj'; planning is off when path maps
+are traced, so the scalar search never runs on a thread.  Each thread
+has its own path_ctx_t and each plan its own path map.  Outside those
+the search only reads: the view map, the city table (for W_TT_BUILD)
+and the change ring, which 'get_planes' reads to bring the thread's
+own planes up to date.  Nothing writes any of these during a batch.
+The planned searches never touch the continent labels, route graphs
+or prune map, which are file-scope state in map.c, nor the flow fields
+of a context; the searches that use those must stay on the main
+thread.
+*/
+
+#define NUM_PLANS 32 /* pieces planned at once */
+
+typedef loc_t (*find_obj_t)(path_ctx_t *, path_map_t *, view_map_t *, loc_t,
+                            move_info_t *, int);
+
+typedef struct {
+	piece_info_t *obj;      /* piece plan is for; NULL once used */
+	loc_t loc;              /* where piece was */
+	move_info_t *move_info; /* objectives searched for */
+	view_map_t *vmap;       /* map searched */
+	find_obj_t find;        /* search to make */
+	int max_cost;           /* farthest the search looks */
+	loc_t new_loc;          /* objective found */
+} plan_t;
+
+static plan_t plans[NUM_PLANS];
+static path_map_t *plan_pmap[NUM_PLANS];
+static view_map_t *plan_amap;    /* map ships search for a fight */
+static int num_plans;            /* plans in current batch */
+static unsigned long plan_clock; /* change clock when planned */
+static int plans_left; /* pieces to move before we plan again */
+
+static pthread_mutex_t plan_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t plan_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t plan_done = PTHREAD_COND_INITIALIZER;
+static path_ctx_t worker_ctx[MAX_PLAN_THREADS];
+static int num_workers; /* threads started, not counting our own */
+static long plan_batch; /* number of batches handed out */
+static int next_plan;   /* next plan for a thread to take */
+static int busy;        /* workers still working on the batch */
+
+/*
+Make room in our maps and search contexts for the current map.  This
+is only called between moves, when no worker is searching.
+*/
+
+void size_comp_maps(void) {
+	int i;
+
+	RESIZE(emap, MAP_SIZE);
+	RESIZE(emap_guess, MAP_SIZE);
+	emap_gen = 0; /* make it afresh */
+	RESIZE(fill_map.marks, MAP_SIZE);
+	RESIZE(fill_map.map, MAP_SIZE);
+	fill_map.made = false;
+	fill_map.num_marks = 0;
+	RESIZE(load_map.marks, MAP_SIZE);
+	RESIZE(load_map.map, MAP_SIZE);
+	load_map.made = false;
+	load_map.num_marks = 0;
+	for (i = 0; i < NUM_PLANS; i++) {
+		RESIZE(plan_pmap[i], MAP_SIZE);
+	}
+	size_cont_labels(&land_conts);
+	size_cont_labels(&lake_conts);
+	size_cont_labels(&unload_conts);
+	size_path_ctx(&path_ctx);
+	for (i = 0; i < num_workers; i++) {
+		size_path_ctx(&worker_ctx[i]);
+	}
+}
+
+/*
+Run the plans of the current batch that no other thread has taken.
+Called with plan_lock held.
+*/
+
+static void run_plans(path_ctx_t *ctx) {
+	plan_t *p;
+	int i;
+
+	while (next_plan < num_plans) {
+		i = next_plan++;
+		p = &plans[i];
+		(void)pthread_mutex_unlock(&plan_lock);
+		p->new_loc = p->find(ctx, plan_pmap[i], p->vmap, p->loc,
+		                     p->move_info, p->max_cost);
+		(void)pthread_mutex_lock(&plan_lock);
+	}
+}
+
+static void *plan_worker(void *arg) {
+	path_ctx_t *ctx = arg;
+	long batch = 0;
+
+	(void)pthread_mutex_lock(&plan_lock);
+	for (;;) {
+		while (plan_batch == batch) {
+			(void)pthread_cond_wait(&plan_ready, &plan_lock);
+		}
+		batch = plan_batch;
+		run_plans(ctx);
+		if (--busy == 0) {
+			(void)pthread_cond_signal(&plan_done);
+		}
+	}
+	/* NOTREACHED */
+	return NULL;
+}
+
+/*
+Decide which search a piece will make first, if it is one we can plan.
+This only has to be a good guess: a plan the piece does not ask for
+is never used.
+*/
+
+static bool plan_search(piece_info_t *obj, plan_t *p) {
+	p->max_cost = INFINITY;
+	switch (obj->type) {
+	case ARMY:
+	case MARINE:
+		if (obj->ship || vmap_at_sea(game.comp_map, obj->loc)) {
+			return false;
+		}
+		p->move_info = &army_fight;
+		p->vmap = game.comp_map;
+		p->find = vmap_find_lobj;
+		return true;
+	case FIGHTER:
+	case BOMBER:
+		p->move_info = &fighter_fight;
+		p->vmap = game.comp_map;
+		p->find = vmap_find_aobj;
+		p->max_cost = obj->range;
+		return true;
+	case TRANSPORT:
+	case SATELLITE:
+		return false;
+	default:
+		if (obj->hits < piece_attr[obj->type].max_hits) {
+			if (game.comp_map[obj->loc].contents == 'X') {
+				return false; /* will stay in port */
+			}
+			p->move_info = &ship_repair;
+			p->vmap = game.comp_map;
+		} else {
+			p->move_info = &ship_fight;
+			p->vmap = plan_amap;
+		}
+		p->find = vmap_find_wobj;
+		return true;
+	}
+}
+
+/*
+Plan the searches of the pieces starting with 'obj'.
+*/
+
+static void make_plans(piece_info_t *obj) {
+	int i;
+
+	while (num_workers < game.plan_threads - 1) {
+		pthread_t thread;
+
+		size_path_ctx(&worker_ctx[num_workers]);
+		if (pthread_create(&thread, NULL, plan_worker,
+		                   &worker_ctx[num_workers]) != 0) {
+			break; /* make do with what we have */
+		}
+		(void)pthread_detach(thread);
+		num_workers++;
+	}
+	plan_amap = clear_map(&fill_map);
+
+	num_plans = 0;
+	for (i = 0; obj != NULL && i < NUM_PLANS; obj = NEXT(obj, piece_link)) {
+		plan_t *p = &plans[num_plans];
+
+		i++;
+		if (plan_search(obj, p)) {
+			p->obj = obj;
+			p->loc = obj->loc;
+			num_plans++;
+		}
+	}
+	plans_left = i;
+	plan_clock = vmap_change_clock();
+
+	(void)pthread_mutex_lock(&plan_lock);
+	next_plan = 0;
+	busy = num_workers;
+	plan_batch++;
+	(void)pthread_cond_broadcast(&plan_ready);
+	run_plans(&path_ctx);
+	while (busy > 0) {
+		(void)pthread_cond_wait(&plan_done, &plan_lock);
+	}
+	(void)pthread_mutex_unlock(&plan_lock);
+}
+
+/*
+Find an objective for a piece no more than 'max_cost' moves away.  We
+use a plan if there is a good one; otherwise we search the given map.
+'*pmap' is set to the path map holding the result.
+*/
+
+static loc_t find_objective(piece_info_t *obj, path_map_t **pmap,
+                            view_map_t *vmap, move_info_t *move_info,
+                            find_obj_t find, int max_cost) {
+	int i;
+
+	for (i = 0; i < num_plans; i++) {
+		plan_t *p = &plans[i];
+
+		if (p->obj != obj) {
+			continue;
+		}
+		p->obj = NULL; /* a plan is only good once */
+		if (p->loc == obj->loc && p->move_info == move_info &&
+		    p->max_cost == max_cost &&
+		    !vmap_path_changed(plan_pmap[i], plan_clock)) {
+			*pmap = plan_pmap[i];
+			return p->new_loc;
+		}
+		break;
+	}
+	*pmap = path_ctx.path_map;
+	return find(&path_ctx, path_ctx.path_map, vmap, obj->loc, move_info,
+	            max_cost);
+}
 
 void do_pieces(void) {
 	void cpiece_move(piece_info_t *);
 
 	int i;
 	piece_info_t *obj, *next_obj;
+	bool planning;
+
+	planning = game.plan_threads > 1 && !game.trace_pmap;
+	num_plans = 0;
+	plans_left = 0;
 
 	for (i = 0; i < NUM_OBJECTS; i++) { /* loop through obj lists */
-		for (obj = game.comp_obj[move_order[i]]; obj != NULL;
+		for (obj = game.obj_list[COMP][move_order[i]]; obj != NULL;
 		     obj = next_obj) { /* loop through objs in list */
-			next_obj = obj->piece_link.next;
+			next_obj = NEXT(obj, piece_link);
+			if (planning && plans_left-- <= 0) {
+				make_plans(obj);
+				plans_left--;
+			}
 			cpiece_move(obj); /* yup; move the object */
 		}
+		plans_left = 0; /* plans stop at the end of a list */
 	}
+	num_plans = 0;
 }
 
 /*
@@ -564,13 +956,15 @@ destination.  (If there is no destination, sit around and wait.)
 void army_move(piece_info_t *obj) {
 	loc_t move_away(view_map_t *, loc_t, char *);
 	loc_t find_attack(loc_t, char *, char *);
-	void make_army_load_map(piece_info_t *, view_map_t *, view_map_t *);
-	void make_unload_map(view_map_t *, view_map_t *);
-	void make_tt_load_map(view_map_t *, view_map_t *);
+	view_map_t *make_army_load_map(piece_info_t *);
+	view_map_t *make_unload_map(void);
 	void board_ship(piece_info_t *, path_map_t *, loc_t);
 
 	loc_t new_loc;
-	path_map_t path_map2[MAP_SIZE];
+	path_map_t *pmap;
+	path_map_t *path_map = path_ctx.path_map;
+	path_map_t *path_map2 = path_ctx.path_map2;
+	view_map_t *amap;
 	int cross_cost = 0; /* cost to enter water */
 
 	obj->func = 0;                              /* army doesn't want a tt */
@@ -597,19 +991,20 @@ void army_move(piece_info_t *obj) {
 		return;
 	}
 	if (obj->ship) {
-		if (obj->ship->func == 0) {
+		if (SHIP(obj)->func == 0) {
 			if (!load_army(obj))
 				ABORT; /* load army on best ship */
 			return;        /* armies stay on a loading ship */
 		}
-		make_unload_map(amap, game.comp_map);
-		new_loc = vmap_find_wlobj(path_map, amap, obj->loc, &tt_unload);
+		amap = make_unload_map();
+		new_loc = vmap_find_wlobj(&path_ctx, path_map, amap, obj->loc,
+		                          &tt_unload);
 		move_objective(obj, path_map, new_loc, " ");
 		return;
 	}
 
-	new_loc =
-	    vmap_find_lobj(path_map, game.comp_map, obj->loc, &army_fight);
+	new_loc = find_objective(obj, &pmap, game.comp_map, &army_fight,
+	                         vmap_find_lobj, INFINITY);
 
 	if (new_loc != obj->loc) { /* something interesting on land? */
 		switch (game.comp_map[new_loc].contents) {
@@ -626,15 +1021,15 @@ void army_move(piece_info_t *obj) {
 		default:
 			ABORT;
 		}
-		cross_cost = path_map[new_loc].cost * 2 - cross_cost;
+		cross_cost = pmap[new_loc].cost * 2 - cross_cost;
 	} else
 		cross_cost = INFINITY;
 
 	if (new_loc == obj->loc || cross_cost > 0) {
 		loc_t new_loc2;
 		/* see if there is something interesting to load */
-		make_army_load_map(obj, amap, game.comp_map);
-		new_loc2 = vmap_find_lwobj(path_map2, amap, obj->loc,
+		amap = make_army_load_map(obj);
+		new_loc2 = vmap_find_lwobj(&path_ctx, path_map2, amap, obj->loc,
 		                           &army_load, cross_cost);
 
 		if (new_loc2 != obj->loc) { /* found something? */
@@ -643,7 +1038,7 @@ void army_move(piece_info_t *obj) {
 		}
 	}
 
-	move_objective(obj, path_map, new_loc, " ");
+	move_objective(obj, pmap, new_loc, " ");
 }
 
 /*
@@ -663,31 +1058,35 @@ Make a load map.  We copy the view map and mark each loading
 transport and tt producing city with a '$'.
 */
 
-void make_army_load_map(piece_info_t *obj, view_map_t *xmap, view_map_t *vmap) {
+view_map_t *make_army_load_map(piece_info_t *obj) {
+	view_map_t *xmap;
+	city_set_t *cs = &game.owned[COMP];
 	piece_info_t *p;
-	int i;
+	int i, k;
 
-	(void)memcpy(xmap, vmap, sizeof(view_map_t) * MAP_SIZE);
+	xmap = clear_map(&load_map);
 
 	/* mark loading transports or cities building transports */
-	for (p = game.comp_obj[TRANSPORT]; p; p = p->piece_link.next)
+	for (p = game.obj_list[COMP][TRANSPORT]; p; p = NEXT(p, piece_link))
 		if (p->func == 0) /* loading tt? */
-			xmap[p->loc].contents = '$';
+			mark_map(&load_map, p->loc, '$');
 
-	for (i = 0; i < NUM_CITY; i++)
-		if (game.city[i].owner == COMP &&
-		    game.city[i].prod == TRANSPORT) {
+	for (k = 0; k < cs->count; k++) {
+		i = cs->index[k];
+		if (game.city[i].prod == TRANSPORT) {
 			if (nearby_load(obj, game.city[i].loc))
-				xmap[game.city[i].loc].contents =
-				    'x'; /* army is nearby so it can load */
+				/* army is nearby so it can load */
+				mark_map(&load_map, game.city[i].loc, 'x');
 			else if (nearby_count(game.city[i].loc) <
 			         piece_attr[TRANSPORT].capacity)
-				xmap[game.city[i].loc].contents =
-				    'x'; /* city needs armies */
+				/* city needs armies */
+				mark_map(&load_map, game.city[i].loc, 'x');
 		}
+	}
 
 	if (game.print_vmap == 'A')
 		print_xzoom(xmap);
+	return xmap;
 }
 
 /* Return true if an army is considered near a location for loading. */
@@ -703,7 +1102,7 @@ count_t nearby_count(loc_t loc) {
 	int count;
 
 	count = 0;
-	for (obj = game.comp_obj[ARMY]; obj; obj = obj->piece_link.next) {
+	for (obj = game.obj_list[COMP][ARMY]; obj; obj = NEXT(obj, piece_link)) {
 		if (nearby_load(obj, loc))
 			count += 1;
 	}
@@ -712,18 +1111,20 @@ count_t nearby_count(loc_t loc) {
 
 /* Make load map for a ship. */
 
-void make_tt_load_map(view_map_t *xmap, view_map_t *vmap) {
+view_map_t *make_tt_load_map(void) {
+	view_map_t *xmap;
 	piece_info_t *p;
 
-	(void)memcpy(xmap, vmap, sizeof(view_map_t) * MAP_SIZE);
+	xmap = clear_map(&load_map);
 
 	/* mark loading armies */
-	for (p = game.comp_obj[ARMY]; p; p = p->piece_link.next)
+	for (p = game.obj_list[COMP][ARMY]; p; p = NEXT(p, piece_link))
 		if (p->func == 1) /* loading army? */
-			xmap[p->loc].contents = '$';
+			mark_map(&load_map, p->loc, '$');
 
 	if (game.print_vmap == 'L')
 		print_xzoom(xmap);
+	return xmap;
 }
 
 /*
@@ -753,31 +1154,21 @@ b)  if enemy_cities == 1 && total_cities == 1, set number to 2.
 c)  Any other attackable city is marked with a '0'.
 */
 
-static int owncont_map[MAP_SIZE];
-static int tcont_map[MAP_SIZE];
-
-void make_unload_map(view_map_t *xmap, view_map_t *vmap) {
+view_map_t *make_unload_map(void) {
+	view_map_t *xmap;
 	count_t i;
 	scan_counts_t counts;
+	char mark;
 
-	(void)memcpy(xmap, vmap, sizeof(view_map_t) * MAP_SIZE);
-	unmark_explore_locs(xmap);
+	xmap = clear_map(&fill_map);
 
 	for (i = 0; i < MAP_SIZE; i++)
-		owncont_map[i] = 0; /* nothing marked */
-
-	for (i = 0; i < NUM_CITY; i++)
-		if (game.city[i].owner == COMP)
-			vmap_mark_up_cont(owncont_map, xmap, game.city[i].loc,
-			                  MAP_SEA);
-
-	for (i = 0; i < MAP_SIZE; i++)
-		if (strchr("O*", vmap[i].contents)) {
+		if (strchr("O*", game.comp_map[i].contents)) {
 			int total_cities;
 
-			vmap_cont(tcont_map, xmap, i,
-			          MAP_SEA); /* game.real_map continent */
-			counts = vmap_cont_scan(tcont_map, xmap);
+			/* game.real_map continent */
+			counts = *vmap_cont_counts(&unload_conts, xmap, i,
+			                           MAP_SEA);
 
 			total_cities = counts.unowned_cities +
 			               counts.user_cities + counts.comp_cities;
@@ -786,21 +1177,25 @@ void make_unload_map(view_map_t *xmap, view_map_t *vmap) {
 				total_cities = 0;
 
 			if (counts.user_cities && counts.comp_cities)
-				xmap[i].contents = '0' + total_cities;
+				mark = '0' + total_cities;
 
 			else if (counts.unowned_cities > counts.user_cities &&
 			         counts.comp_cities == 0)
-				xmap[i].contents = '0' + total_cities;
+				mark = '0' + total_cities;
 
 			else if (counts.user_cities == 1 &&
 			         counts.comp_cities == 0)
-				xmap[i].contents = '2';
+				mark = '2';
 
 			else
-				xmap[i].contents = '0';
+				mark = '0';
+
+			mark_map(&fill_map, i, mark);
+			vmap_cont_note(&unload_conts, i);
 		}
 	if (game.print_vmap == 'U')
 		print_xzoom(xmap);
+	return xmap;
 }
 
 /*
@@ -825,7 +1220,7 @@ one of the ships to become more full.
 piece_info_t *find_best_tt(piece_info_t *best, loc_t loc) {
 	piece_info_t *p;
 
-	for (p = game.real_map[loc].objp; p != NULL; p = p->loc_link.next)
+	for (p = game.real_map[loc].objp; p != NULL; p = NEXT(p, loc_link))
 		if (p->type == TRANSPORT && obj_capacity(p) > p->count) {
 			if (!best)
 				best = p;
@@ -843,7 +1238,7 @@ bool load_army(piece_info_t *obj) {
 	piece_info_t *p;
 	int i;
 
-	p = find_best_tt(obj->ship, obj->loc); /* look here first */
+	p = find_best_tt(SHIP(obj), obj->loc); /* look here first */
 
 	for (i = 0; i < 8; i++) { /* try surrounding squares */
 		loc_t x_loc = obj->loc + dir_offset[i];
@@ -925,7 +1320,12 @@ Transports become 'loading' when empty, and 'unloading' when full.
 */
 
 void transport_move(piece_info_t *obj) {
+	view_map_t *make_tt_load_map(void);
+	view_map_t *make_unload_map(void);
+
 	loc_t new_loc;
+	path_map_t *path_map = path_ctx.path_map;
+	view_map_t *amap;
 
 	/* empty transports can attack */
 	if (obj->count == 0) { /* empty? */
@@ -941,23 +1341,24 @@ void transport_move(piece_info_t *obj) {
 		obj->func = 1;               /* unloading */
 
 	if (obj->func == 0) { /* loading? */
-		make_tt_load_map(amap, game.comp_map);
-		new_loc = vmap_find_wlobj(path_map, amap, obj->loc, &tt_load);
+		amap = make_tt_load_map();
+		new_loc = vmap_find_wlobj(&path_ctx, path_map, amap, obj->loc,
+		                          &tt_load);
 
 		if (new_loc == obj->loc) { /* nothing to load? */
-			(void)memcpy(amap, game.comp_map,
-			             MAP_SIZE * sizeof(view_map_t));
-			unmark_explore_locs(amap);
+			amap = clear_map(&fill_map);
 			if (game.print_vmap == 'S')
 				print_xzoom(amap);
-			new_loc = vmap_find_wobj(path_map, amap, obj->loc,
-			                         &tt_explore);
+			new_loc =
+			    vmap_find_wobj(&path_ctx, path_map, amap, obj->loc,
+			                   &tt_explore, INFINITY);
 		}
 
 		move_objective(obj, path_map, new_loc, "a ");
 	} else {
-		make_unload_map(amap, game.comp_map);
-		new_loc = vmap_find_wlobj(path_map, amap, obj->loc, &tt_unload);
+		amap = make_unload_map();
+		new_loc = vmap_find_wlobj(&path_ctx, path_map, amap, obj->loc,
+		                          &tt_unload);
 		move_objective(obj, path_map, new_loc, " ");
 	}
 }
@@ -976,6 +1377,8 @@ if there is one in range.
 
 void fighter_move(piece_info_t *obj) {
 	loc_t new_loc;
+	path_map_t *path_map = path_ctx.path_map;
+	path_map_t *pmap = path_map;
 
 	new_loc = find_attack(obj->loc, fighter_attack, ".+");
 	if (new_loc != obj->loc) {    /* something to attack? */
@@ -986,16 +1389,17 @@ void fighter_move(piece_info_t *obj) {
 	if (obj->range <= find_nearest_city(obj->loc, COMP, &new_loc) + 2) {
 		if (new_loc != obj->loc)
 			new_loc =
-			    vmap_find_dest(path_map, game.comp_map, obj->loc,
-			                   new_loc, COMP, T_AIR);
+			    vmap_find_dest(&path_ctx, path_map, game.comp_map,
+			                   obj->loc, new_loc, COMP, T_AIR);
 	} else
 		new_loc = obj->loc;
 
 	if (new_loc == obj->loc) { /* no nearby city? */
-		new_loc = vmap_find_aobj(path_map, game.comp_map, obj->loc,
-		                         &fighter_fight);
+		new_loc = find_objective(obj, &pmap, game.comp_map,
+		                         &fighter_fight, vmap_find_aobj,
+		                         obj->range);
 	}
-	move_objective(obj, path_map, new_loc, " ");
+	move_objective(obj, pmap, new_loc, " ");
 }
 
 /*
@@ -1007,6 +1411,8 @@ something to attack.
 
 void ship_move(piece_info_t *obj) {
 	loc_t new_loc;
+	path_map_t *pmap;
+	view_map_t *amap;
 	char *adj_list;
 
 	if (obj->hits < piece_attr[obj->type].max_hits) { /* head to port */
@@ -1015,8 +1421,8 @@ void ship_move(piece_info_t *obj) {
 			obj->moved = piece_attr[obj->type].speed;
 			return;
 		}
-		new_loc = vmap_find_wobj(path_map, game.comp_map, obj->loc,
-		                         &ship_repair);
+		new_loc = find_objective(obj, &pmap, game.comp_map,
+		                         &ship_repair, vmap_find_wobj, INFINITY);
 		adj_list = ".";
 
 	} else {
@@ -1026,17 +1432,16 @@ void ship_move(piece_info_t *obj) {
 			return;
 		}
 		/* look for an objective */
-		(void)memcpy(amap, game.comp_map,
-		             MAP_SIZE * sizeof(view_map_t));
-		unmark_explore_locs(amap);
+		amap = clear_map(&fill_map);
 		if (game.print_vmap == 'S')
 			print_xzoom(amap);
 
-		new_loc = vmap_find_wobj(path_map, amap, obj->loc, &ship_fight);
+		new_loc = find_objective(obj, &pmap, amap, &ship_fight,
+		                         vmap_find_wobj, INFINITY);
 		adj_list = ship_fight.objectives;
 	}
 
-	move_objective(obj, path_map, new_loc, adj_list);
+	move_objective(obj, pmap, new_loc, adj_list);
 }
 
 /*
@@ -1069,7 +1474,7 @@ void move_objective(piece_info_t *obj, path_map_t pathmap[], loc_t new_loc,
 		vmap_mark_adjacent(pathmap, obj->loc);
 		reuse = false;
 	} else
-		vmap_mark_path(pathmap, game.comp_map,
+		vmap_mark_path(&path_ctx, pathmap, game.comp_map,
 		               new_loc); /* find routes to destination */
 
 	/* path terrain and move terrain may differ */
@@ -1193,21 +1598,13 @@ void check_endgame(void) {
 		player_army[i] = 0;
 	}
 
-	/* Count cities for each player */
-	for (i = 0; i < NUM_CITY; i++) {
-		if (game.city[i].owner >= USER && game.city[i].owner <= USER4 && game.player[game.city[i].owner - USER].alive)
-			player_city[game.city[i].owner - USER]++;
-	}
-
-	/* Count armies for each player */
-	for (i = 0; i < NUM_OBJECTS; i++) {
-		for (p = game.user_obj[i]; p != NULL; p = p->piece_link.next) {
-			if (p->owner >= USER && p->owner <= USER4 && game.player[p->owner - USER].alive) {
-				if (p->type == ARMY) {
-					player_army[p->owner - USER]++;
-				}
-			}
-		}
+	/* Count cities and armies for each player */
+	for (i = 0; i <= USER4 - USER; i++) {
+		if (!game.player[i].alive)
+			continue;
+		player_city[i] = game.owned[USER + i].count;
+		for (p = LIST(USER + i)[ARMY]; p; p = NEXT(p, piece_link))
+			player_army[i]++;
 	}
 
 	/* Check for winner - last player standing */
@@ -1224,7 +1621,9 @@ void check_endgame(void) {
 		if (game.player[i].alive && player_city[i] == 0 && player_army[i] == 0) {
 			/* Player is eliminated */
 			game.player[i].alive = false;
-			sprintf(game.jnkbuf, "%s has been eliminated from the game.\n", game.player[i].name);
+			sprintf(game.jnkbuf,
+			        "%s has been eliminated from the game.\n",
+			        game.player[i].name);
 			announce(game.jnkbuf);
 		}
 	}
@@ -1241,13 +1640,14 @@ void check_endgame(void) {
 	if (players_alive == 1) {
 		/* We have a winner */
 		game.win = 1; /* human victory */
-		sprintf(game.jnkbuf, "%s has won the game!\n", game.player[last_player].name);
+		sprintf(game.jnkbuf, "%s has won the game!\n",
+		        game.player[last_player].name);
 		announce(game.jnkbuf);
 	}
 
 	/* Check for computer surrender (if any human players are alive) */
 	int human_players_alive = 0;
-	int comp_cities = 0;
+	int comp_cities = game.owned[COMP].count;
 	int comp_armies = 0;
 
 	for (i = 0; i < game.num_players; i++) {
@@ -1257,17 +1657,8 @@ void check_endgame(void) {
 	}
 
 	/* Count computer forces */
-	for (i = 0; i < NUM_CITY; i++) {
-		if (game.city[i].owner == COMP)
-			comp_cities++;
-	}
-
-	for (i = 0; i < NUM_OBJECTS; i++) {
-		for (p = game.comp_obj[i]; p != NULL; p = p->piece_link.next) {
-			if (p->type == ARMY)
-				comp_armies++;
-		}
-	}
+	for (p = game.obj_list[COMP][ARMY]; p != NULL; p = NEXT(p, piece_link))
+		comp_armies++;
 
 	/* Computer surrenders if overwhelmed */
 	if (human_players_alive > 0 && comp_cities > 0 && comp_armies > 0) {
@@ -1283,7 +1674,8 @@ void check_endgame(void) {
 
 		if (comp_cities * 2 < total_human_cities && comp_armies * 2 < total_human_armies) {
 			game.win = 1; /* human victory */
-			sprintf(game.jnkbuf, "The computer acknowledges defeat.\n");
+			sprintf(game.jnkbuf,
+			        "The computer acknowledges defeat.\n");
 			announce(game.jnkbuf);
 		}
 	}
@@ -78,16 +78,22 @@ piece_attr_t piece_attr[] = {
 		".+", 30, 2, 1, 6, 0, 80}
 };
 
-/* Direction offsets. */
+/* Direction offsets, filled in for the map size by 'set_map_size'. */
 
-int dir_offset [] = {-MAP_WIDTH, /* north */
-		     -MAP_WIDTH+1, /* northeast */
-		     1, /* east */
-		     MAP_WIDTH+1, /* southeast */
-		     MAP_WIDTH, /* south */
-		     MAP_WIDTH-1, /* southwest */
-		     -1, /* west */
-		     -MAP_WIDTH-1}; /* northwest */
+int dir_offset [8];
+
+/* Rows and columns moved in each direction. */
+
+int dir_row [] = {-1, /* north */
+		  -1, /* northeast */
+		  0, /* east */
+		  1, /* southeast */
+		  1, /* south */
+		  1, /* southwest */
+		  0, /* west */
+		  -1}; /* northwest */
+
+int dir_col [] = {0, 1, 1, 1, 0, -1, -1, -1};
 
 /* Names of movement functions. */
 
@@ -210,6 +216,23 @@ move_info_t user_ship_repair = {
 	USER, "O",   {1}
 };
 
+/* the destination of 'vmap_find_dest', marked '%', for each owner */
+move_info_t dest_info[MAX_PLAYERS] = {
+	{UNOWNED, "%", {1}}, {USER, "%", {1}},  {USER2, "%", {1}},
+	{USER3, "%", {1}},   {USER4, "%", {1}}, {COMP, "%", {1}}
+};
+
+/* every move_info above, so that they can be compiled at startup */
+
+move_info_t *move_infos[] = {
+	&tt_explore, &tt_load, &tt_unload, &army_fight, &army_load,
+	&fighter_fight, &ship_fight, &ship_repair, &user_army,
+	&user_army_attack, &user2_army, &user2_army_attack, &user3_army,
+	&user3_army_attack, &user4_army, &user4_army_attack, &user_fighter,
+	&user_ship, &user_ship_repair, &dest_info[USER], &dest_info[USER2],
+	&dest_info[USER3], &dest_info[USER4], &dest_info[COMP], NULL
+};
+
 /*
 Various help texts.
 */
@@ -623,14 +623,14 @@ void print_pzoom_cell(path_map_t *pmap, view_map_t *vmap, int row, int col,
 
 	for (r = row; r < row + row_inc; r++) {
 		for (c = col; c < col + col_inc; c++) {
-			sum += pmap[row_col_loc(r, c)].cost;
+			sum += PMAP_COST(pmap, row_col_loc(r, c));
 			d += 1;
 		}
 	}
 	// cppcheck-suppress zerodiv
 	sum /= d;
 
-	if (pmap[row_col_loc(row, col)].terrain == T_PATH)
+	if (PMAP_TERRAIN(pmap, row_col_loc(row, col)) == T_PATH)
 		cell = '-';
 	else if (sum < 0)
 		cell = '!';
@@ -784,9 +784,9 @@ void print_movie_cell(char *mbuf, int row, int col, int row_inc, int col_inc) {
 	cell = ' ';
 	for (r = row; r < row + row_inc; r++) {
 		for (c = col; c < col + col_inc; c++) {
-			if (strchr(zoom_list, mbuf[row_col_loc(r, c)]) <
+			if (strchr(zoom_list, mbuf[r * MAP_WIDTH + c]) <
 			    strchr(zoom_list, cell)) {
-				cell = mbuf[row_col_loc(r, c)];
+				cell = mbuf[r * MAP_WIDTH + c];
 			}
 		}
 	}
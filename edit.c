@@ -351,7 +351,7 @@ void e_wake(loc_t loc) {
 		}
 	}
 	for (obj = game.real_map[loc].objp; obj != NULL;
-	     obj = obj->loc_link.next) {
+	     obj = NEXT(obj, loc_link)) {
 		obj->func = NOFUNC;
 	}
 }
@@ -519,7 +519,7 @@ void e_city_info(loc_t edit_cursor) {
 
 	f = 0; /* no fighters counted yet */
 	for (obj = game.real_map[edit_cursor].objp; obj != NULL;
-	     obj = obj->loc_link.next) {
+	     obj = NEXT(obj, loc_link)) {
 		if (obj->type == FIGHTER) {
 			f++;
 		}
@@ -527,7 +527,7 @@ void e_city_info(loc_t edit_cursor) {
 
 	s = 0; /* no ships counted yet */
 	for (obj = game.real_map[edit_cursor].objp; obj != NULL;
-	     obj = obj->loc_link.next) {
+	     obj = NEXT(obj, loc_link)) {
 		if (obj->type >= DESTROYER) {
 			s++;
 		}
@@ -33,10 +33,15 @@ void empire(void) {
 
 	char order;
 	int turn = 0;
+	move_info_t **mi;
 
 	ttinit(); /* init tty */
 	rndini(); /* init random number generator */
 
+	for (mi = move_infos; *mi != NULL; mi++) {
+		compile_move_info(*mi);
+	}
+
 	/* Show title screen with player colors */
 	show_title();
 
@@ -271,24 +276,17 @@ it as the computers.
 */
 
 void c_give(void) {
-	int unowned[NUM_CITY];
 	count_t i, count;
 
-	count = 0; /* nothing in list yet */
-	for (i = 0; i < NUM_CITY; i++) {
-		if (game.city[i].owner == UNOWNED) {
-			unowned[count] = i; /* remember this city */
-			count += 1;
-		}
-	}
+	count = game.owned[UNOWNED].count;
 	if (count == 0) {
 		error("There are no unowned cities.");
 		ksend("There are no unowned cities.");
 		return;
 	}
 	i = irand(count);
-	i = unowned[i]; /* get city index */
-	game.city[i].owner = COMP;
+	i = game.owned[UNOWNED].index[i]; /* get city index */
+	set_city_owner(&game.city[i], COMP);
 	game.city[i].prod = NOPIECE;
 	game.city[i].work = 0;
 	scan(game.comp_map, game.city[i].loc);
@@ -336,6 +334,10 @@ void c_debug(char order) {
 		game.print_vmap = get_chx();
 		break;
 
+	case '*': /* piece pool statistics */
+		describe_pool();
+		break;
+
 	default:
 		huh();
 		break;
@@ -374,7 +376,7 @@ out the map.
 void c_map(void) {
 	FILE *f;
 	int i, j;
-	char line[MAP_HEIGHT + 2];
+	char line[MAX_MAP_HEIGHT + 2];
 
 	prompt("Filename? ");
 	get_str(game.jnkbuf, STRSIZE);
@@ -11,6 +11,7 @@ empire.h -- type and constant declarations
 */
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifndef NULL
 #define NULL 0
@@ -58,6 +59,7 @@ typedef long count_t; /* for iterating over or counting board locations */
 #define USER4 4
 #define COMP 5
 #define MAX_PLAYERS 6
+#define NUM_OWNERS (COMP + 1) /* UNOWNED through COMP */
 
 /* Piece types. */
 #define ARMY 0
@@ -74,7 +76,8 @@ typedef long count_t; /* for iterating over or counting board locations */
 #define NUM_OBJECTS 11       /* number of defined objects */
 #define NOPIECE ((char)255) /* a 'null' piece */
 
-#define LIST_SIZE 5000 /* max number of pieces on board */
+#define LIST_SIZE (game.list_size) /* slots in the piece pool */
+#define MAX_PLAN_THREADS 16 /* most threads planning computer moves */
 
 typedef struct city_info {
 	loc_t loc;              /* location of city */
@@ -122,58 +125,80 @@ Macro to convert a movement function into a direction.
 Information we maintain about each piece.
 */
 
-typedef struct {                 /* ptrs for doubly linked list */
-	struct piece_info *next; /* pointer to next in list */
-	struct piece_info *prev; /* pointer to prev in list */
+typedef int32_t piece_id_t; /* 1 + index in the pool, or 0 for none */
+
+typedef struct {         /* links for doubly linked list */
+	piece_id_t next; /* next in list */
+	piece_id_t prev; /* prev in list */
 } link_t;
 
+/*
+The fields walked every turn come first, and a whole piece fits in a
+64-byte cache line; locations fit in 32 bits even on the largest map.
+Links between pieces are ids rather than pointers; list heads are
+still pointers.  The pool is kept in slabs of SLAB_SIZE pieces (see
+'grow_pool'), and each piece remembers its own id.
+*/
+
 typedef struct piece_info {
 	link_t piece_link;        /* linked list of pieces of this type */
 	link_t loc_link;          /* linked list of pieces at a location */
+	link_t sector_link;       /* linked list of pieces in a sector */
+	int32_t loc;              /* location of piece */
+	piece_id_t id;            /* id of this piece */
+	signed char hits;         /* hits left */
+	signed char moved;        /* moves made */
+	signed char owner;        /* owner of piece */
+	signed char type;         /* type of piece */
+	signed char count;        /* count of items on board */
+	bool entrenched;          /* true if army/marine is entrenched on sentry */
+	short range;              /* current range (if applicable) */
+	piece_id_t ship;          /* containing ship */
 	link_t cargo_link;        /* linked list of cargo pieces */
-	int owner;                /* owner of piece */
-	int type;                 /* type of piece */
-	loc_t loc;                /* location of piece */
-	long func;                /* programmed type of movement */
-	short hits;               /* hits left */
-	int moved;                /* moves made */
-	struct piece_info *ship;  /* pointer to containing ship */
+	int32_t func;             /* programmed type of movement */
 	struct piece_info *cargo; /* pointer to cargo list */
-	short count;              /* count of items on board */
-	short range;              /* current range (if applicable) */
-	bool entrenched;          /* true if army/marine is entrenched on sentry */
 } piece_info_t;
 
+#define PIECE(id)                                                              \
+	((id) ? &game.slab[((id)-1) / SLAB_SIZE][((id)-1) % SLAB_SIZE] : NULL)
+#define PIECE_ID(obj) ((obj) ? (obj)->id : 0)
+#define NEXT(obj, list) PIECE((obj)->list.next)
+#define PREV(obj, list) PIECE((obj)->list.prev)
+#define SHIP(obj) PIECE((obj)->ship)
+
 /*
 Macros to link and unlink an object from a doubly linked list.
 */
 
 #define LINK(head, obj, list)                                                  \
 	{                                                                      \
-		obj->list.prev = NULL;                                         \
-		obj->list.next = head;                                         \
+		obj->list.prev = 0;                                            \
+		obj->list.next = PIECE_ID(head);                               \
 		if (head)                                                      \
-			head->list.prev = obj;                                 \
+			head->list.prev = PIECE_ID(obj);                       \
 		head = obj;                                                    \
 	}
 
 #define UNLINK(head, obj, list)                                                \
 	{                                                                      \
 		if (obj->list.next)                                            \
-			obj->list.next->list.prev = obj->list.prev;            \
+			NEXT(obj, list)->list.prev = obj->list.prev;           \
 		if (obj->list.prev)                                            \
-			obj->list.prev->list.next = obj->list.next;            \
+			PREV(obj, list)->list.next = obj->list.next;           \
 		else                                                           \
-			head = obj->list.next;                                 \
-		obj->list.next =                                               \
-		    NULL; /* encourage mem faults in buggy code */             \
-		obj->list.prev = NULL;                                         \
+			head = NEXT(obj, list);                                \
+		obj->list.next = 0;                                            \
+		obj->list.prev = 0;                                            \
 	}
 
 /* macros to set map and list of an object */
 #define MAP(owner) (((owner) == USER || (owner) == USER2 || (owner) == USER3 || (owner) == USER4) ? game.user_map : game.comp_map)
-#define LIST(owner) (((owner) == USER || (owner) == USER2 || (owner) == USER3 || (owner) == USER4) ? game.user_obj : game.comp_obj)
+#define LIST(owner) (game.obj_list[owner])
 #define IS_HUMAN(owner) ((owner) >= USER && (owner) <= USER4)
+
+/* give an array room for 'count' elements, zeroed; see 'resize_array' */
+#define RESIZE(array, count)                                                   \
+	((array) = resize_array((array), (count), sizeof(*(array))))
 #define CURRENT_PLAYER() (game.current_player == 0 ? USER : game.current_player == 1 ? USER2 : game.current_player == 2 ? USER3 : game.current_player == 3 ? USER4 : USER)
 #define IS_ATTACKER_HUMAN(att_owner) ((att_owner) >= USER && (att_owner) <= USER4)
 #define IS_DEFENDER_HUMAN(def_owner) ((def_owner) >= USER && (def_owner) <= USER4)
@@ -183,8 +208,10 @@ Macros to link and unlink an object from a doubly linked list.
 /* macro to step through adjacent cells */
 #define FOR_ADJ(loc, new_loc, i)                                               \
 	for (i = 0; (i < 8 ? new_loc = loc + dir_offset[i], 1 : 0); i++)
+/* the same, skipping cells off the board; only edge cells test them */
 #define FOR_ADJ_ON(loc, new_loc, i)                                            \
-	FOR_ADJ(loc, new_loc, i) if (game.real_map[new_loc].on_board)
+	FOR_ADJ(loc, new_loc, i)                                               \
+	if (game.real_map[loc].inner || game.real_map[new_loc].on_board)
 
 /*
 We maintain attributes for each piece.  Attributes are currently constant,
@@ -217,44 +244,104 @@ it tells whether or not a square is on the board.
 'user_map' describes the user's view of the world.  'comp_map' describes
 the computer's view of the world.
 
-As of the 1.7 version, MAP_WIDTH and MAP_HEIGHT are now free paramaters.
-You can change them and the code will adjust properly.
+MAP_WIDTH and MAP_HEIGHT are chosen when the game starts (see
+'set_map_size'), up to MAX_MAP_WIDTH by MAX_MAP_HEIGHT.  The maps and
+every other array whose size follows the map are allocated to fit
+then, so a small map takes little memory.
+
+The maps are laid out with rows MAP_STRIDE cells apart, a power of two
+at least MAP_PAD larger than MAP_WIDTH, and with a spare row above and
+below.  Every cell of the world thus has all eight neighbors in the
+arrays, and the padding around it is off the board; a satellite's
+sweep, which reaches MAP_PAD - 1 columns to either side, stops in the
+padding rather than wrapping onto the next row.  MAP_CELLS counts the
+cells of the world itself, which save files and movies number row by
+row (see 'loc_cell').
 */
 
-#define MAP_WIDTH 100
-#define MAP_HEIGHT 60
-#define MAP_SIZE (MAP_WIDTH * MAP_HEIGHT)
+#define DEF_MAP_WIDTH 100
+#define DEF_MAP_HEIGHT 60
+#define MIN_MAP_WIDTH 40
+#define MIN_MAP_HEIGHT 24
+#define MAX_MAP_WIDTH 500
+#define MAX_MAP_HEIGHT 300
+#define MAP_PAD 8 /* least padding at the end of each row */
+
+#define MAP_WIDTH (game.map_width)
+#define MAP_HEIGHT (game.map_height)
+#define MAP_SHIFT (game.map_shift)
+#define MAP_STRIDE (1 << MAP_SHIFT)
+#define MAP_CELLS (MAP_WIDTH * MAP_HEIGHT)
+#define MAP_SIZE (MAP_STRIDE * (MAP_HEIGHT + 2))
 
 /* #define NUM_CITY 70 */
 /* #define NUM_CITY (MAP_SIZE / 85) */
-#define NUM_CITY ((100 * (MAP_WIDTH + MAP_HEIGHT)) / 228)
+#define CITIES_FOR(w, h) ((100 * ((w) + (h))) / 228)
+#define NUM_CITY (game.num_city)
 #define NUM_CITY_BOX 20 /* Fewer cities for box map mode */
 
+typedef struct city_set { /* cities with one owner */
+	int count;        /* cities in the set */
+	int *index;       /* their indices in game.city, ascending */
+} city_set_t;
+
+/* room for a piece in every 1.2 cells, or 5000 on the 100x60 map */
+#define PIECES_FOR(w, h) ((w) * (h) * 5 / 6)
+/* the pool grows a slab at a time, for as long as memory lasts */
+#define SLAB_SIZE 256
+
 typedef struct real_map {   /* a cell of the actual map */
 	char contents;      /* MAP_LAND, MAP_SEA, or MAP_CITY */
 	bool on_board;      /* TRUE iff on the board */
+	bool inner;         /* TRUE iff all eight neighbors are on the board */
 	city_info_t *cityp; /* ptr to city at this location */
 	piece_info_t *objp; /* list of objects at this location */
+	piece_info_t *top;  /* the one to show; see 'stack_changed' */
 } real_map_t;
 
-typedef struct view_map { /* a cell of one player's world view */
-	char contents;    /* MAP_LAND, MAP_SEA, MAP_CITY, 'A', 'a', etc */
-	long seen;        /* date when last updated */
+/*
+A cell of one player's world view.  The dates cells were last seen are
+kept apart in 'comp_seen' and 'user_seen', so that the searches, which
+only look at contents, walk a dense array of bytes.
+*/
+
+typedef struct view_map {
+	char contents; /* MAP_LAND, MAP_SEA, MAP_CITY, 'A', 'a', etc */
 } view_map_t;
 
+typedef int32_t seen_t; /* turn a view cell was last updated */
+typedef int32_t sight_t; /* pieces and cities watching a view cell */
+
 /* Define information we maintain for a pathmap. */
 
 typedef struct {
-	int cost;     /* total cost to get here */
-	int inc_cost; /* incremental cost to get here */
-	char terrain; /* T_LAND, T_WATER, T_UNKNOWN, T_PATH */
+	int cost;          /* total cost to get here */
+	int inc_cost;      /* incremental cost to get here */
+	char terrain;      /* T_LAND, T_WATER, T_UNKNOWN, T_PATH */
+	unsigned int gen;  /* search generation that last wrote this cell */
 } path_map_t;
 
+/*
+A path map is not cleared between searches.  Instead each search bumps
+the map's generation, which is kept in location 0 (a border corner that
+is never on the board), and a cell is only meaningful if it carries the
+current generation.  Any other cell reads as lying outside the perimeter.
+*/
+
+#define PMAP_GEN(pmap) ((pmap)[0].gen)
+#define PMAP_VALID(pmap, loc) ((pmap)[loc].gen == PMAP_GEN(pmap))
+#define PMAP_COST(pmap, loc)                                                   \
+	(PMAP_VALID(pmap, loc) ? (pmap)[loc].cost : INFINITY)
+#define PMAP_TERRAIN(pmap, loc)                                                \
+	(PMAP_VALID(pmap, loc) ? (pmap)[loc].terrain : T_UNKNOWN)
+
 #define T_UNKNOWN 0
 #define T_PATH 1
 #define T_LAND 2
 #define T_WATER 4
 #define T_AIR (T_LAND | T_WATER)
+#define T_FROM 8  /* terrain of the cell a search came from */
+#define T_REAL 16 /* terrain of the real map */
 
 /* A record for counts we obtain when scanning a continent. */
 
@@ -268,6 +355,34 @@ typedef struct {
 	int unexplored;     /* unexplored territory */
 } scan_counts_t;
 
+/*
+Every continent of a view map, labelled at once, with the counts for
+each continent (see 'vmap_cont_counts').  The cells of a continent are
+chained together so that it can be joined to another.  No two
+continents are adjacent, so no 2x2 block of cells holds more than one
+continent.
+*/
+
+#define NUM_CONTS (((MAP_WIDTH + 1) / 2) * ((MAP_HEIGHT + 1) / 2))
+#define CONT_SETS 256 /* cells noted by 'vmap_cont_note' between uses */
+
+typedef struct {
+	view_map_t *vmap;                /* map labelled; NULL if none */
+	char bad_terrain;                /* terrain off the continents */
+	unsigned long synced;            /* change clock at last update */
+	int *label;                      /* continent of each cell, or -1 */
+	char *seen;                      /* contents counted for each cell */
+	char *owner;                     /* owner of any city counted there */
+	loc_t *next;                     /* next cell of a continent, or -1 */
+	loc_t *first;                    /* first cell of each continent */
+	int num_conts;                   /* continent numbers handed out */
+	int num_free;                    /* numbers freed by joins */
+	int *free_conts;                 /* those numbers */
+	int set_len;                     /* cells noted since last use */
+	loc_t set[CONT_SETS];            /* those cells */
+	scan_counts_t *counts;           /* counts for each continent */
+} cont_labels_t;
+
 /* Define useful constants for accessing sectors. */
 
 #define SECTOR_ROWS 5 /* number of vertical sectors */
@@ -282,18 +397,116 @@ typedef struct {
 	char city_owner;  /* char that represents home city */
 	char *objectives; /* list of objectives */
 	int weights[11];  /* weight of each objective */
+
+	/* filled in from the above by 'compile_move_info' */
+	int weight_of[256]; /* weight of each cell contents */
+	char terrain[256];  /* terrain of each cell contents */
 } move_info_t;
 
 /* special weights */
 #define W_TT_BUILD -1 /* special cost for city building a tt */
+#define W_NONE -2     /* contents is not an objective */
 
 /* List of cells in the perimeter of our searching for a path. */
 
 typedef struct {
-	long len;            /* number of items in list */
-	long list[MAP_SIZE]; /* list of locations */
+	long len;   /* number of items in list */
+	long *list; /* list of locations; room for MAP_SIZE */
 } perimeter_t;
 
+/*
+Scratch state for path searches.  Every search works in a context
+passed to it rather than in static storage, so searches on different
+contexts can run at the same time.  A context is large, so each thread
+should keep one and reuse it.  Its arrays are allocated to fit the map
+by 'size_path_ctx'.  The context also holds the path maps and the view
+map its owner fills in between searches, and the flow fields of recent
+searches for a destination (see 'vmap_find_dest').
+*/
+
+#define NUM_PERIMS 3 /* perimeter lists in a context */
+#define MAX_STEP 2   /* largest cost of a single search step */
+#define NUM_BUCKETS (MAX_STEP + 1)
+#define NUM_FLOWS 16 /* flow fields in a context */
+
+typedef struct {
+	loc_t head; /* first cell in list, or -1 */
+	loc_t tail; /* last cell in list */
+} cell_list_t;
+
+/*
+Bitboards.  A row of the map is held in MAP_WORDS 64-bit words, with
+column c in bit c % 64 of word c / 64.  Searches that cost one per
+move keep a few sets of bit planes describing a view map (see
+'vmap_find_xobj').
+*/
+
+#define MAP_WORDS ((MAP_WIDTH + 63) / 64) /* words in a bitboard row */
+#define MAX_MAP_WORDS ((MAX_MAP_WIDTH + 63) / 64)
+#define NUM_PLANES 8 /* plane sets in a context */
+
+typedef uint64_t bit_row_t[MAX_MAP_WORDS];
+
+typedef struct {
+	view_map_t *vmap;          /* map described; NULL if unused */
+	move_info_t *move_info;    /* objectives */
+	int expand;                /* terrain the search crosses */
+	long last_use;             /* when planes were last used */
+	unsigned long synced;      /* change clock planes are up to date with */
+	bool *made;      /* true once a row is filled in */
+	bit_row_t *pass; /* cells the search crosses */
+	bit_row_t *stop; /* cells reached but not crossed */
+	bit_row_t *wet;  /* crossable cells that are water */
+	bit_row_t *goal; /* objectives */
+} bit_planes_t;
+
+typedef struct {
+	int *cost;           /* moves to reach each node */
+	int *est;            /* cost plus distance still to go */
+	int *from;           /* node each node was reached from */
+	unsigned long *seen; /* search that last reached each node */
+	unsigned long gen;   /* number of the current search */
+	int *heap;           /* nodes to look at, cheapest estimate first */
+	int *heap_at;        /* place of each node in heap, or -1 */
+	int heap_len;        /* nodes in heap */
+} route_scratch_t;
+
+typedef struct {
+	view_map_t *vmap;     /* map field was built from; NULL if unused */
+	loc_t dest;           /* destination */
+	int owner;            /* owner of pieces using field */
+	int terrain;          /* terrain pieces can cross */
+	long date;            /* turn field was built */
+	long last_use;        /* when field was last used */
+	unsigned long synced; /* change clock field is up to date with */
+	int *dist;            /* moves to dest; INFINITY if unreachable */
+	char *state;          /* whether each cell was looked at, and open */
+} flow_field_t;
+
+typedef struct {
+	perimeter_t perim[NUM_PERIMS];       /* perimeter lists */
+	int best_cost;                       /* cost of best objective */
+	loc_t best_loc;                      /* location of best objective */
+	cell_list_t buckets[NUM_BUCKETS][2]; /* bucket queue: water, land */
+	loc_t *bucket_link;                  /* next cell in a bucket list */
+	long bucket_count;                   /* number of cells in the queue */
+	bit_planes_t planes[NUM_PLANES];     /* planes of recent searches */
+	long plane_clock;                    /* uses of planes so far */
+	bit_row_t *seen;                     /* cells a search reached */
+	bit_row_t *front;                    /* cells on the perimeter */
+	bit_row_t *next;                     /* cells on the next perimeter */
+	bit_row_t *spread;                   /* perimeter grown sideways */
+	bit_row_t *cand;                     /* objectives on the perimeter */
+	bit_row_t *listed;                   /* cells put in perimeter lists */
+	flow_field_t flows[NUM_FLOWS];       /* fields of recent searches */
+	long flow_clock;                     /* uses of fields so far */
+	path_map_t *path_map;                /* path map for the owner */
+	path_map_t *path_map2;               /* and a second one */
+	view_map_t *scratch;                 /* view map for the owner */
+	route_scratch_t route;               /* see 'route_waypoint' */
+	int box; /* cluster a search keeps to, or -1 for anywhere */
+} path_ctx_t;
+
 enum win_t { no_win, wipeout_win, ratio_win };
 
 #define MAP_LAND '+'
@@ -322,10 +535,21 @@ typedef struct {
 	player_info_t player[MAX_PLAYERS]; /* player information */
 
 	/* the world */
-	real_map_t real_map[MAP_SIZE]; /* the way the world really looks */
-	view_map_t comp_map[MAP_SIZE]; /* computer's view of the world */
-	view_map_t user_map[MAP_SIZE]; /* user's view of the world */
-	city_info_t city[NUM_CITY];    /* city information */
+	int map_width;  /* size of the world; see 'set_map_size' */
+	int map_height;
+	int map_shift;  /* row stride is 1 << map_shift */
+	int num_city;   /* cities on the map */
+	int list_size;  /* slots in the piece pool; see 'grow_pool' */
+	/* allocated to fit the map by 'set_map_size' */
+	real_map_t *real_map; /* the way the world really looks */
+	view_map_t *comp_map; /* computer's view of the world */
+	view_map_t *user_map; /* user's view of the world */
+	seen_t *comp_seen;    /* date comp_map cells were seen */
+	seen_t *user_seen;    /* date user_map cells were seen */
+	sight_t *comp_sight;  /* watchers of comp_map cells */
+	sight_t *user_sight;  /* watchers of user_map cells */
+	city_info_t *city;    /* city information */
+	city_set_t owned[NUM_OWNERS];      /* cities of each owner */
 
 	/* miscellaneous */
 	long date;            /* number of game turns played */
@@ -338,6 +562,7 @@ typedef struct {
 	bool print_debug;     /* true iff we print debugging stuff */
 	char print_vmap;      /* the map-printing mode */
 	bool trace_pmap;      /* true if we are tracing pmaps */
+	int plan_threads;     /* threads planning computer moves */
 	int win;              /* set when game is over - not a bool */
 	char jnkbuf[STRSIZE]; /* general purpose temporary buffer */
 	bool save_movie;      /* true iff we should save movie screens */
@@ -347,15 +572,17 @@ typedef struct {
 	bool showprod;
 
 	/*
-	  There is one array to hold all allocated objects no matter who
-	  owns them.  Objects are allocated from the array and placed on
+	  There is one pool to hold all allocated objects no matter who
+	  owns them.  Objects are allocated from the pool and placed on
 	  a list corresponding to the type of object and its owner.
 	*/
 
 	piece_info_t *free_list; /* index to free items in object list */
-	piece_info_t *user_obj[NUM_OBJECTS]; /* indices to user lists */
-	piece_info_t *comp_obj[NUM_OBJECTS]; /* indices to computer lists */
-	piece_info_t object[LIST_SIZE];      /* object list */
+	piece_info_t *obj_list[NUM_OWNERS][NUM_OBJECTS]; /* lists by owner */
+	/* the same pieces again by sector; see 'sector_link' */
+	piece_info_t *sector_obj[NUM_OWNERS][NUM_SECTORS][NUM_OBJECTS];
+	piece_info_t **slab; /* the pool, SLAB_SIZE pieces a slab */
+	long num_slabs;      /* slabs allocated */
 
 	/* Display information. */
 	int lines; /* lines on screen */
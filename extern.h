@@ -22,6 +22,8 @@ size_t buf_vappend(char **cursor, size_t *remaining, const char *fmt,
 /* constant data */
 extern piece_attr_t piece_attr[];
 extern int dir_offset[];
+extern int dir_row[];
+extern int dir_col[];
 extern char *func_name[];
 extern int move_order[];
 extern char type_chars[];
@@ -49,6 +51,8 @@ extern move_info_t user4_army_attack;
 extern move_info_t user_fighter;
 extern move_info_t user_ship;
 extern move_info_t user_ship_repair;
+extern move_info_t dest_info[];
+extern move_info_t *move_infos[];
 extern void ai_city_production(int owner);
 extern void ai_player_move(int owner);
 extern loc_t find_attack(loc_t, char *, char *);
@@ -66,9 +70,13 @@ extern void check_endgame(void);
 #define display_loc_c(loc) display_loc(COMP, comp_map, loc)
 #define print_sector_u(sector) print_sector(USER, game.user_map, sector)
 #define print_sector_c(sector) print_sector(COMP, game.comp_map, sector)
-#define loc_row(loc) ((loc) / MAP_WIDTH)
-#define loc_col(loc) ((loc) % MAP_WIDTH)
-#define row_col_loc(row, col) ((long)((row)*MAP_WIDTH + (col)))
+#define loc_row(loc) (((loc) >> MAP_SHIFT) - 1)
+#define loc_col(loc) ((loc) & (MAP_STRIDE - 1))
+#define row_col_loc(row, col) ((long)((row) + 1) * MAP_STRIDE + (col))
+#define loc_on_map(loc)                                                        \
+	((unsigned long)loc_row(loc) < MAP_HEIGHT && loc_col(loc) < MAP_WIDTH)
+#define loc_cell(loc) (loc_row(loc) * MAP_WIDTH + loc_col(loc))
+#define cell_loc(cell) row_col_loc((cell) / MAP_WIDTH, (cell) % MAP_WIDTH)
 #define sector_row(sector) ((sector) % SECTOR_ROWS)
 #define sector_col(sector) ((sector) / SECTOR_ROWS)
 #define row_col_sector(row, col) ((int)((col)*SECTOR_ROWS + (row)))
@@ -88,31 +96,57 @@ void empire(void);
 
 void attack(piece_info_t *att_obj, long loc);
 void comp_move(int nmoves);
+void size_comp_maps(void);
 void user_move(void);
+void size_user_maps(void);
 void edit(long edit_cursor);
 
 /* map routines */
-void vmap_cont(int *cont_map, view_map_t *vmap, long loc, char bad_terrain);
+void size_search_maps(void);
+void size_path_ctx(path_ctx_t *ctx);
+void size_cont_labels(cont_labels_t *cl);
+void vmap_cont(path_ctx_t *ctx, int *cont_map, view_map_t *vmap, long loc,
+               char bad_terrain);
 void rmap_cont(int *cont_map, long loc, char bad_terrain);
-void vmap_mark_up_cont(int *cont_map, view_map_t *vmap, long loc,
-                       char bad_terrain);
+void vmap_mark_up_cont(path_ctx_t *ctx, int *cont_map, view_map_t *vmap,
+                       long loc, char bad_terrain);
 scan_counts_t vmap_cont_scan(int *cont_map, view_map_t *vmap);
 scan_counts_t rmap_cont_scan(int *cont_map);
 bool map_cont_edge(const int *cont_map, long loc);
-long vmap_find_aobj(path_map_t path_map[], view_map_t *vmap, long loc,
-                    move_info_t *move_info);
-long vmap_find_wobj(path_map_t path_map[], view_map_t *vmap, long loc,
-                    move_info_t *move_info);
-long vmap_find_lobj(path_map_t path_map[], view_map_t *vmap, long loc,
-                    move_info_t *move_info);
-long vmap_find_lwobj(path_map_t path_map[], view_map_t *vmap, long loc,
-                     move_info_t *move_info, int beat_cost);
-long vmap_find_wlobj(path_map_t path_map[], view_map_t *vmap, long loc,
-                     move_info_t *move_info);
-long vmap_find_dest(path_map_t path_map[], view_map_t vmap[], long cur_loc,
-                    long dest_loc, int owner, int terrain);
-void vmap_prune_explore_locs(view_map_t *vmap);
-void vmap_mark_path(path_map_t *path_map, view_map_t *vmap, long dest);
+scan_counts_t *vmap_cont_counts(cont_labels_t *cl, view_map_t *vmap, long loc,
+                                char bad_terrain);
+int vmap_cont_id(cont_labels_t *cl, view_map_t *vmap, long loc,
+                 char bad_terrain);
+void vmap_cont_note(cont_labels_t *cl, long loc);
+void vmap_cont_forget(cont_labels_t *cl);
+void vmap_cont_refresh(cont_labels_t *cl);
+void vmap_cont_recheck(cont_labels_t *cl, perimeter_t *cells);
+long vmap_find_aobj(path_ctx_t *ctx, path_map_t path_map[], view_map_t *vmap,
+                    long loc, move_info_t *move_info, int max_cost);
+long vmap_find_wobj(path_ctx_t *ctx, path_map_t path_map[], view_map_t *vmap,
+                    long loc, move_info_t *move_info, int max_cost);
+long vmap_find_lobj(path_ctx_t *ctx, path_map_t path_map[], view_map_t *vmap,
+                    long loc, move_info_t *move_info, int max_cost);
+long vmap_find_lwobj(path_ctx_t *ctx, path_map_t path_map[], view_map_t *vmap,
+                     long loc, move_info_t *move_info, int beat_cost);
+long vmap_find_wlobj(path_ctx_t *ctx, path_map_t path_map[], view_map_t *vmap,
+                     long loc, move_info_t *move_info);
+long vmap_find_dest(path_ctx_t *ctx, path_map_t path_map[], view_map_t vmap[],
+                    long cur_loc, long dest_loc, int owner, int terrain);
+bool vmap_route_far(long from, long dest, int terrain);
+long vmap_find_flow_dir(path_ctx_t *ctx, view_map_t vmap[], long cur_loc,
+                        long dest_loc, int owner, int terrain,
+                        char *move_terrain, char *adj_char);
+void vmap_changed(long loc);
+void vmap_forget(void);
+unsigned long vmap_change_clock(void);
+bool vmap_changes(unsigned long since, perimeter_t *list);
+bool vmap_path_changed(path_map_t *pmap, unsigned long since);
+long vmap_prune_explore_locs(path_ctx_t *ctx, view_map_t *vmap);
+long vmap_prune_explore_near(path_ctx_t *ctx, view_map_t *vmap, bool *guess,
+                             perimeter_t *cells, long blank);
+void vmap_mark_path(path_ctx_t *ctx, path_map_t *path_map, view_map_t *vmap,
+                    long dest);
 void vmap_mark_adjacent(path_map_t path_map[], long loc);
 void vmap_mark_near_path(path_map_t path_map[], long loc);
 long vmap_find_dir(path_map_t path_map[], view_map_t *vmap, long loc,
@@ -122,6 +156,7 @@ bool vmap_shore(view_map_t *vmap, long loc);
 bool rmap_shore(long loc);
 bool vmap_at_sea(view_map_t *vmap, long loc);
 bool rmap_at_sea(long loc);
+void compile_move_info(move_info_t *move_info);
 
 /* display routines */
 void announce(char *);
@@ -147,7 +182,8 @@ void close_disp(void);
 void pos_str(int row, int col, char *str, ...);
 int direction(chtype c);
 
-void init_game(void); /* game routines */
+bool set_map_size(int width, int height); /* game routines */
+void init_game(void);
 void save_game(void);
 int restore_game(void);
 void save_movie_screen(void);
@@ -174,10 +210,15 @@ piece_info_t *find_obj(int type, long loc);
 piece_info_t *find_nfull(int type, long loc);
 long find_transport(int owner, long loc);
 piece_info_t *find_obj_at_loc(long loc);
+void stack_changed(long loc);
 int obj_moves(piece_info_t *obj);
 int obj_capacity(piece_info_t *obj);
 void kill_obj(piece_info_t *obj, long loc);
+void enter_sector(piece_info_t *obj);
+void leave_sector(piece_info_t *obj);
 void kill_city(city_info_t *cityp);
+void set_city_owner(city_info_t *cityp, int owner);
+void index_cities(void);
 void produce(city_info_t *cityp);
 void move_obj(piece_info_t *obj, long new_loc);
 void move_sat(piece_info_t *obj);
@@ -185,8 +226,13 @@ bool good_loc(piece_info_t *obj, long loc);
 void embark(piece_info_t *ship, piece_info_t *obj);
 void disembark(piece_info_t *obj);
 void describe_obj(piece_info_t *obj);
+void size_pool(long size);
+void count_pool(void);
+void describe_pool(void);
 void scan(view_map_t vmap[], long loc);
 void scan_sat(view_map_t *vmap, long loc);
+void index_sight(void);
+void date_sight(void);
 void set_prod(city_info_t *cityp);
 
 /* terminal routines */
@@ -211,4 +257,6 @@ void empend(void);
 char upper(char c);
 void tupper(char *str);
 void check(void);
+void *resize_array(void *array, size_t count, size_t size);
+void *grow_array(void *array, size_t old_count, size_t count, size_t size);
 int loc_disp(int loc);
@@ -20,12 +20,79 @@ game.c -- Routines to initialize, save, and restore a game.
 
 count_t remove_land(loc_t loc, count_t num_land);
 bool select_cities(void);
+static void size_cont_tab(void);
+static void mark_inner_cells(void);
 bool find_next(loc_t *mapi);
 bool good_cont(loc_t mapi);
 bool xread(FILE *f, char *buf, int size);
 bool xwrite(FILE *f, char *buf, int size);
 void stat_display(char *mbuf, int round);
 
+/*
+Choose the size of the world.  The row stride is the smallest power of
+two at least MAP_PAD wider than the map, and the number of cities and
+the room for pieces grow with the map.  We return false if the map is
+too small to play on or too big for us.
+
+Every array whose size follows the map is allocated afresh here when
+the size changes, which loses what it held.  So this is only done
+before a game is made or restored.
+*/
+
+static loc_t *land;      /* see 'place_cities' */
+static int *marked;      /* see 'select_cities' */
+static int *heights[2];  /* see 'make_map' */
+static char *mapbuf;     /* see 'save_movie_screen' */
+
+bool set_map_size(int width, int height) {
+	int i;
+
+	if (width < MIN_MAP_WIDTH || width > MAX_MAP_WIDTH ||
+	    height < MIN_MAP_HEIGHT || height > MAX_MAP_HEIGHT) {
+		return false;
+	}
+	game.list_size = PIECES_FOR(width, height);
+	if (width == game.map_width && height == game.map_height) {
+		return true; /* everything fits already */
+	}
+	game.map_width = width;
+	game.map_height = height;
+	for (game.map_shift = 1; MAP_STRIDE < width + MAP_PAD;
+	     game.map_shift++) {
+		;
+	}
+	game.num_city = CITIES_FOR(width, height);
+
+	for (i = 0; i < 8; i++) {
+		dir_offset[i] = dir_row[i] * MAP_STRIDE + dir_col[i];
+	}
+
+	RESIZE(game.real_map, MAP_SIZE);
+	RESIZE(game.comp_map, MAP_SIZE);
+	RESIZE(game.user_map, MAP_SIZE);
+	RESIZE(game.comp_seen, MAP_SIZE);
+	RESIZE(game.user_seen, MAP_SIZE);
+	RESIZE(game.comp_sight, MAP_SIZE);
+	RESIZE(game.user_sight, MAP_SIZE);
+	RESIZE(game.city, NUM_CITY);
+	for (i = 0; i < NUM_OWNERS; i++) {
+		RESIZE(game.owned[i].index, NUM_CITY);
+		game.owned[i].count = 0;
+	}
+	RESIZE(land, MAP_SIZE);
+	RESIZE(marked, MAP_SIZE);
+	/* one spare height; the smoothing loop may read a cell too far */
+	RESIZE(heights[0], MAP_CELLS + 1);
+	RESIZE(heights[1], MAP_CELLS + 1);
+	RESIZE(mapbuf, MAP_CELLS);
+	size_cont_tab();
+
+	size_search_maps();
+	size_comp_maps();
+	size_user_maps();
+	return true;
+}
+
 /*
 Initialize a new game.  Here we generate a new random map, put cities
 on the map, select cities for each opponent, and zero out the lists of
@@ -65,23 +132,27 @@ void init_game(void) {
 
 	for (i = 0; i < MAP_SIZE; i++) {
 		game.user_map[i].contents = ' '; /* nothing seen yet */
-		game.user_map[i].seen = 0;
+		game.user_seen[i] = 0;
 		game.comp_map[i].contents = ' ';
-		game.comp_map[i].seen = 0;
-	}
-	for (i = 0; i < NUM_OBJECTS; i++) {
-		game.user_obj[i] = NULL;
-		game.comp_obj[i] = NULL;
+		game.comp_seen[i] = 0;
 	}
+	vmap_forget();
+	(void)memset(game.obj_list, 0, sizeof(game.obj_list));
+	(void)memset(game.sector_obj, 0, sizeof(game.sector_obj));
+	(void)memset(game.comp_sight, 0, MAP_SIZE * sizeof(sight_t));
+	(void)memset(game.user_sight, 0, MAP_SIZE * sizeof(sight_t));
 	game.free_list = NULL;            /* nothing free yet */
+	size_pool(LIST_SIZE);
 	for (i = 0; i < LIST_SIZE; i++) { /* for each object */
-		piece_info_t *obj = &(game.object[i]);
+		piece_info_t *obj = PIECE(i + 1);
 		obj->hits = 0; /* mark object as dead */
 		obj->owner = UNOWNED;
 		LINK(game.free_list, obj, piece_link);
 	}
+	count_pool();
 
 	make_map(); /* make land and water */
+	mark_inner_cells();
 
 		do {
 		for (i = 0; i < MAP_SIZE; i++) { /* remove cities */
@@ -90,6 +161,8 @@ void init_game(void) {
 			}
 		}
 		place_cities();     /* place cities on game.real_map */
+		index_cities();     /* all unowned, and nobody watching */
+		index_sight();
 	} while (!select_cities()); /* choose a city for each player */
 
 	/* Reset to first player after city selection */
@@ -120,16 +193,48 @@ at program start up.
 
 #define MAX_HEIGHT 999 /* highest height */
 
-/* these arrays give some compilers problems when they are automatic */
-/* MAP_SIZE+1 to eleminate compiler warning. I think the loop is wrong
-   and goes 1 too high, but safer to just increase here */
-static int height[2][MAP_SIZE + 1];
 static int height_count[MAX_HEIGHT + 1];
 
+/* Empty the map, leaving every cell off the board. */
+
+static void clear_real_map(void) {
+	loc_t loc;
+
+	for (loc = 0; loc < MAP_SIZE; loc++) {
+		game.real_map[loc].contents = MAP_SEA;
+		game.real_map[loc].on_board = false;
+		game.real_map[loc].objp = NULL; /* nothing in cell yet */
+		game.real_map[loc].top = NULL;
+		game.real_map[loc].cityp = NULL;
+	}
+}
+
+/* Note the cells whose eight neighbors are all on the board. */
+
+static void mark_inner_cells(void) {
+	loc_t loc, new_loc;
+	int i;
+
+	for (loc = 0; loc < MAP_SIZE; loc++) {
+		game.real_map[loc].inner = game.real_map[loc].on_board;
+		if (!game.real_map[loc].on_board) {
+			continue;
+		}
+		FOR_ADJ(loc, new_loc, i) {
+			if (!game.real_map[new_loc].on_board) {
+				game.real_map[loc].inner = false;
+			}
+		}
+	}
+}
+
 void make_map(void) {
 	int from, to, k;
 	count_t i, j, sum;
 	loc_t loc;
+	int cell_offset[8];
+
+	clear_real_map();
 
 	/* If box_map mode, create a simple rectangular land mass */
 	if (game.box_map) {
@@ -139,43 +244,51 @@ void make_map(void) {
 		int box_left = MAP_WIDTH / 4;
 		int box_right = MAP_WIDTH * 3 / 4;
 		
-		for (i = 0; i < MAP_SIZE; i++) {
-			int row = loc_row(i);
-			int col = loc_col(i);
-			
+		for (i = 0; i < MAP_CELLS; i++) {
+			int row = i / MAP_WIDTH;
+			int col = i % MAP_WIDTH;
+
+			loc = cell_loc(i);
 			/* Check if inside the box */
 			if (row >= box_top && row < box_bottom && col >= box_left && col < box_right) {
-				game.real_map[i].contents = MAP_LAND;
+				game.real_map[loc].contents = MAP_LAND;
 			} else {
-				game.real_map[i].contents = MAP_SEA;
+				game.real_map[loc].contents = MAP_SEA;
 			}
-			game.real_map[i].objp = NULL;
-			game.real_map[i].cityp = NULL;
-			game.real_map[i].on_board = !(col == 0 || col == MAP_WIDTH - 1 ||
-			                              row == 0 || row == MAP_HEIGHT - 1);
+			game.real_map[loc].on_board = !(col == 0 || col == MAP_WIDTH - 1 ||
+			                                row == 0 || row == MAP_HEIGHT - 1);
 		}
 		return;
 	}
 
-	for (i = 0; i < MAP_SIZE;
+	for (i = 0; i < MAP_CELLS;
 	     i++) { /* fill game.real_map with random sand */
-		height[0][i] = irand(MAX_HEIGHT);
+		heights[0][i] = irand(MAX_HEIGHT);
+	}
+
+	/*
+	Heights are kept by cell number, so 'dir_offset' does not find
+	their neighbors.  A cell at the end of a row is smoothed with the
+	start of the next, as it always has been.
+	*/
+	for (k = 0; k < 8; k++) {
+		cell_offset[k] = dir_row[k] * MAP_WIDTH + dir_col[k];
 	}
 
 	from = 0;
 	to = 1;
 	for (i = 0; i < game.SMOOTH; i++) { /* smooth the game.real_map */
-		for (j = 0; j < MAP_SIZE; j++) {
-			sum = height[from][j];
+		for (j = 0; j < MAP_CELLS; j++) {
+			sum = heights[from][j];
 			for (k = 0; k < 8; k++) {
-				loc = j + dir_offset[k];
+				loc = j + cell_offset[k];
 				/* edges get smoothed in a wierd fashion */
-				if (loc < 0 || loc >= MAP_SIZE) {
+				if (loc < 0 || loc >= MAP_CELLS) {
 					loc = j;
 				}
-				sum += height[from][loc];
+				sum += heights[from][loc];
 			}
-			height[to][j] = sum / 9;
+			heights[to][j] = sum / 9;
 		}
 		k = to; /* swap to and from */
 		to = from;
@@ -187,8 +300,8 @@ void make_map(void) {
 		height_count[i] = 0;
 	}
 
-	for (i = 0; i < MAP_SIZE; i++) {
-		height_count[height[from][i]]++;
+	for (i = 0; i < MAP_CELLS; i++) {
+		height_count[heights[from][i]]++;
 	}
 
 	/* find the water line */
@@ -196,7 +309,7 @@ void make_map(void) {
 	sum = 0;
 	for (i = 0; i <= MAX_HEIGHT; i++) {
 		sum += height_count[i];
-		if (sum * 100 / MAP_SIZE > game.WATER_RATIO &&
+		if (sum * 100 / MAP_CELLS > game.WATER_RATIO &&
 		    sum >= NUM_CITY) {
 			loc = i; /* this is last height that is water */
 			break;
@@ -204,21 +317,20 @@ void make_map(void) {
 	}
 
 	/* mark the land and water */
-	for (i = 0; i < MAP_SIZE; i++) {
-		if (height[from][i] > loc) {
-			game.real_map[i].contents = MAP_LAND;
+	for (i = 0; i < MAP_CELLS; i++) {
+		loc_t xloc = cell_loc(i);
+
+		if (heights[from][i] > loc) {
+			game.real_map[xloc].contents = MAP_LAND;
 		} else {
-			game.real_map[i].contents = MAP_SEA;
+			game.real_map[xloc].contents = MAP_SEA;
 		}
 
-		game.real_map[i].objp = NULL; /* nothing in cell yet */
-		game.real_map[i].cityp = NULL;
-
-		j = loc_col(i);
-		k = loc_row(i);
+		j = loc_col(xloc);
+		k = loc_row(xloc);
 
-		game.real_map[i].on_board = !(j == 0 || j == MAP_WIDTH - 1 ||
-		                              k == 0 || k == MAP_HEIGHT - 1);
+		game.real_map[xloc].on_board = !(j == 0 || j == MAP_WIDTH - 1 ||
+		                                 k == 0 || k == MAP_HEIGHT - 1);
 	}
 }
 
@@ -230,9 +342,6 @@ list until all the cities are placed.  After each choice of a land cell
 for a city, we remove land cells which are too close to the city.
 */
 
-/* avoid compiler problems with large automatic arrays */
-static loc_t land[MAP_SIZE];
-
 void place_cities(void) {
 	count_t regen_land(count_t);
 
@@ -362,7 +471,7 @@ making sure the cities are not the same.
 typedef struct cont {                 /* a continent */
 	long value;                   /* value of continent */
 	int ncity;                    /* number of cities */
-	city_info_t *cityp[NUM_CITY]; /* pointer to city */
+	city_info_t **cityp;          /* pointer to city; see 'size_cont_tab' */
 } cont_t;
 
 typedef struct pair {
@@ -371,12 +480,21 @@ typedef struct pair {
 	int comp_cont; /* index to computer continent */
 } pair_t;
 
-static int marked[MAP_SIZE];      /* list of examine cells */
 static int ncont;                 /* number of continents */
 static cont_t cont_tab[MAX_CONT]; /* list of good continenets */
 static int rank_tab[MAX_CONT];    /* indices to cont_tab in order of rank */
 static pair_t pair_tab[MAX_CONT * MAX_CONT]; /* ranked pairs of continents */
 
+/* Give each continent room for every city. */
+
+static void size_cont_tab(void) {
+	int i;
+
+	for (i = 0; i < MAX_CONT; i++) {
+		RESIZE(cont_tab[i].cityp, NUM_CITY);
+	}
+}
+
 bool select_cities(void) {
 	void find_cont(void), make_pair(void);
 
@@ -459,10 +577,10 @@ bool select_cities(void) {
 				assigned_city_locs[i] = best_city->loc;
 				/* Set owner */
 				switch (i) {
-					case 0: best_city->owner = USER; break;
-					case 1: best_city->owner = USER2; break;
-					case 2: best_city->owner = USER3; break;
-					case 3: best_city->owner = USER4; break;
+					case 0: set_city_owner(best_city, USER); break;
+					case 1: set_city_owner(best_city, USER2); break;
+					case 2: set_city_owner(best_city, USER3); break;
+					case 3: set_city_owner(best_city, USER4); break;
 				}
 			best_city->work = 0;
 			scan(game.user_map, best_city->loc);
@@ -568,11 +686,11 @@ bool select_cities(void) {
 
 		/* Assign proper owner value - USER, USER2, USER3, USER4 are not sequential */
 		switch (i) {
-			case 0: player_city->owner = USER; break;
-			case 1: player_city->owner = USER2; break;
-			case 2: player_city->owner = USER3; break;
-			case 3: player_city->owner = USER4; break;
-			default: player_city->owner = USER; break;
+			case 0: set_city_owner(player_city, USER); break;
+			case 1: set_city_owner(player_city, USER2); break;
+			case 2: set_city_owner(player_city, USER3); break;
+			case 3: set_city_owner(player_city, USER4); break;
+			default: set_city_owner(player_city, USER); break;
 		}
 		player_city->work = 0;
 		scan(game.user_map, player_city->loc);
@@ -777,7 +895,7 @@ tell the user why.
 /* Save-file format identifiers. */
 #define SAVE_MAGIC "EMPIRE-SAVE"
 #define SAVE_MAGIC_LEN 11
-#define SAVE_VERSION 2
+#define SAVE_VERSION 3
 
 #if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
 #define STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)
@@ -813,19 +931,20 @@ Maps:
   real_map: for each cell (map_size)
     u8 contents
     u8 on_board
-  comp_map: for each cell
-    u8 contents
-    i64 seen
-  user_map: for each cell
-    u8 contents
-    i64 seen
+  comp_map: contents of each cell, then dates
+    u8 contents[map_size]
+    i32 seen[map_size]
+  user_map: likewise
+    u8 contents[map_size]
+    i32 seen[map_size]
+  (version 2 interleaved u8 contents and i64 seen for each cell)
 Cities: num_city records
   i32 loc
   u8 owner
   i64 work
   u8 prod
   i64 func[num_objects]
-Objects: list_size records
+Objects: list_size records (the pool may have grown past its start)
   i32 owner
   i32 type
   i32 loc
@@ -835,8 +954,42 @@ Objects: list_size records
   i32 count
   i32 range
 Pointers and lists are reconstructed on load.
+Cells are numbered row by row from 0 to map_size - 1, whatever the
+layout of the maps in memory; see 'save_loc'.
+*/
+
+/*
+Convert between locations and the cell numbers save files hold.  Only
+locations on the board are converted.  Other values pass through
+unchanged: negative movement functions, and the 0 and 1 the computer
+keeps in 'func' for loading and unloading.  Neither 0 nor 1 is the
+number of a cell on the board, since the top row is off it.  Cell
+numbers past the end of the map become locations past MAP_SIZE.
 */
 
+static long save_loc(long loc) {
+	if (loc <= 1 || loc >= MAP_SIZE || !game.real_map[loc].on_board) {
+		return loc;
+	}
+	return loc_cell(loc);
+}
+
+static long restore_loc(long cell) {
+	if (cell <= 1) {
+		return cell;
+	}
+	return cell < MAP_CELLS ? cell_loc(cell) : MAP_SIZE;
+}
+
+/* Convert a movement function, making sure it comes back the same. */
+
+static long save_func(long func) {
+	long cell = save_loc(func);
+
+	ASSERT(restore_loc(cell) == func);
+	return cell;
+}
+
 static bool write_u8(FILE *f, uint8_t v) {
 	return xwrite(f, (char *)&v, (int)sizeof(v));
 }
@@ -946,12 +1099,13 @@ void save_game(void) {
 		perror("Cannot save saved game");
 		return;
 	}
+	date_sight(); /* watched cells are seen today */
 
 	S_WBYTES(SAVE_MAGIC, SAVE_MAGIC_LEN);
 	S_WU32(SAVE_VERSION);
 	S_WU32(MAP_WIDTH);
 	S_WU32(MAP_HEIGHT);
-	S_WU32(MAP_SIZE);
+	S_WU32(MAP_CELLS);
 	S_WU32(NUM_CITY);
 	S_WU32(LIST_SIZE);
 	S_WU32(NUM_OBJECTS);
@@ -975,36 +1129,41 @@ void save_game(void) {
 		S_WI32(game.player[i].score);
 	}
 
-	for (i = 0; i < MAP_SIZE; i++) {
-		S_WU8(game.real_map[i].contents);
-		S_WU8(game.real_map[i].on_board);
+	for (i = 0; i < MAP_CELLS; i++) {
+		S_WU8(game.real_map[cell_loc(i)].contents);
+		S_WU8(game.real_map[cell_loc(i)].on_board);
 	}
 
-	for (i = 0; i < MAP_SIZE; i++) {
-		S_WU8(game.comp_map[i].contents);
-		S_WI64(game.comp_map[i].seen);
+	for (i = 0; i < MAP_CELLS; i++) {
+		S_WU8(game.comp_map[cell_loc(i)].contents);
 	}
-	for (i = 0; i < MAP_SIZE; i++) {
-		S_WU8(game.user_map[i].contents);
-		S_WI64(game.user_map[i].seen);
+	for (i = 0; i < MAP_CELLS; i++) {
+		S_WI32(game.comp_seen[cell_loc(i)]);
+	}
+	for (i = 0; i < MAP_CELLS; i++) {
+		S_WU8(game.user_map[cell_loc(i)].contents);
+	}
+	for (i = 0; i < MAP_CELLS; i++) {
+		S_WI32(game.user_seen[cell_loc(i)]);
 	}
 
 	for (i = 0; i < NUM_CITY; i++) {
-		S_WI32(game.city[i].loc);
+		S_WI32(save_loc(game.city[i].loc));
 		S_WU8(game.city[i].owner);
 		S_WI64(game.city[i].work);
 		S_WU8((uint8_t)game.city[i].prod);
 		for (j = 0; j < NUM_OBJECTS; j++) {
-			S_WI64(game.city[i].func[j]);
+			S_WI64(save_func(game.city[i].func[j]));
 		}
 	}
 
 	for (i = 0; i < LIST_SIZE; i++) {
-		piece_info_t *obj = &game.object[i];
+		piece_info_t *obj = PIECE(i + 1);
 		S_WI32(obj->owner);
 		S_WI32(obj->type);
-		S_WI32(obj->loc);
-		S_WI64(obj->func);
+		S_WI32(save_loc(obj->loc));
+		S_WI64(obj->hits > 0 ? save_func(obj->func)
+		                      : save_loc(obj->func));
 		S_WI32(obj->hits);
 		S_WI32(obj->moved);
 		S_WI32(obj->count);
@@ -1046,9 +1205,12 @@ int restore_game(void) {
 	uint32_t v_u32;
 	int32_t v_i32;
 	int64_t v_i64;
-	uint32_t map_width, map_height, map_size;
+	uint32_t version, map_width, map_height, map_size;
 	uint32_t num_city, list_size, num_objects;
 	char magic[SAVE_MAGIC_LEN];
+	int old_width = MAP_WIDTH;
+	int old_height = MAP_HEIGHT;
+	int old_list_size = LIST_SIZE;
 
 	f = fopen(game.savefile, "rb"); /* open for input */
 	if (f == NULL) {
@@ -1087,10 +1249,10 @@ int restore_game(void) {
 		fprintf(stderr, "Saved file has unknown format.\n");
 		goto restore_cleanup;
 	}
-	R_RU32(v_u32);
-	if (v_u32 != SAVE_VERSION) {
+	R_RU32(version);
+	if (version != SAVE_VERSION && version != 2) {
 		fprintf(stderr, "Saved file version %u is not supported.\n",
-		        v_u32);
+		        version);
 		goto restore_cleanup;
 	}
 
@@ -1101,21 +1263,23 @@ int restore_game(void) {
 	R_RU32(list_size);
 	R_RU32(num_objects);
 
-	if (map_width != MAP_WIDTH || map_height != MAP_HEIGHT ||
-	    map_size != MAP_SIZE) {
+	if (map_size != map_width * map_height ||
+	    !set_map_size((int)map_width, (int)map_height)) {
 		fprintf(stderr,
-		        "Saved file map is %ux%u (size %u); this build uses %dx%d (size %d).\n",
-		        map_width, map_height, map_size, MAP_WIDTH, MAP_HEIGHT,
-		        MAP_SIZE);
+		        "Saved file map is %ux%u (size %u); this build allows %dx%d to %dx%d.\n",
+		        map_width, map_height, map_size, MIN_MAP_WIDTH,
+		        MIN_MAP_HEIGHT, MAX_MAP_WIDTH, MAX_MAP_HEIGHT);
 		goto restore_cleanup;
 	}
-	if (num_city != NUM_CITY || list_size != LIST_SIZE ||
+	if (num_city != NUM_CITY || list_size < (uint32_t)LIST_SIZE ||
 	    num_objects != NUM_OBJECTS) {
 		fprintf(stderr,
 		        "Saved file uses different limits (cities %u, objects %u, list %u).\n",
 		        num_city, num_objects, list_size);
 		goto restore_cleanup;
 	}
+	game.list_size = (int)list_size; /* the pool may have grown */
+	size_pool(LIST_SIZE);
 
 	R_RI64(game.date);
 	R_RU8(game.automove);
@@ -1165,29 +1329,53 @@ int restore_game(void) {
 		}
 	}
 
+	clear_real_map();
 	for (i = 0; i < MAP_SIZE; i++) {
-		R_RU8(game.real_map[i].contents);
-		R_RU8(game.real_map[i].on_board);
-		game.real_map[i].on_board = !!game.real_map[i].on_board;
-		game.real_map[i].cityp = NULL;
-		game.real_map[i].objp = NULL;
+		game.comp_map[i].contents = ' ';
+		game.user_map[i].contents = ' ';
 	}
-	for (i = 0; i < MAP_SIZE; i++) {
-		R_RU8(game.comp_map[i].contents);
-		R_RI64(game.comp_map[i].seen);
+	for (i = 0; i < MAP_CELLS; i++) {
+		real_map_t *rp = &game.real_map[cell_loc(i)];
+
+		R_RU8(rp->contents);
+		R_RU8(rp->on_board);
+		rp->on_board = !!rp->on_board;
 	}
-	for (i = 0; i < MAP_SIZE; i++) {
-		R_RU8(game.user_map[i].contents);
-		R_RI64(game.user_map[i].seen);
+	mark_inner_cells();
+	if (version == 2) {
+		for (i = 0; i < MAP_CELLS; i++) {
+			R_RU8(game.comp_map[cell_loc(i)].contents);
+			R_RI64(game.comp_seen[cell_loc(i)]);
+		}
+		for (i = 0; i < MAP_CELLS; i++) {
+			R_RU8(game.user_map[cell_loc(i)].contents);
+			R_RI64(game.user_seen[cell_loc(i)]);
+		}
+	} else {
+		for (i = 0; i < MAP_CELLS; i++) {
+			R_RU8(game.comp_map[cell_loc(i)].contents);
+		}
+		for (i = 0; i < MAP_CELLS; i++) {
+			R_RI32(game.comp_seen[cell_loc(i)]);
+		}
+		for (i = 0; i < MAP_CELLS; i++) {
+			R_RU8(game.user_map[cell_loc(i)].contents);
+		}
+		for (i = 0; i < MAP_CELLS; i++) {
+			R_RI32(game.user_seen[cell_loc(i)]);
+		}
 	}
+	vmap_forget();
 
 	for (i = 0; i < NUM_CITY; i++) {
 		R_RI32(game.city[i].loc);
+		game.city[i].loc = restore_loc(game.city[i].loc);
 		R_RU8(game.city[i].owner);
 		R_RI64(game.city[i].work);
 		R_RU8(game.city[i].prod);
 		for (j = 0; j < NUM_OBJECTS; j++) {
 			R_RI64(game.city[i].func[j]);
+			game.city[i].func[j] = restore_loc(game.city[i].func[j]);
 		}
 		if (game.city[i].owner != UNOWNED && game.city[i].owner != USER &&
 		    game.city[i].owner != COMP && game.city[i].owner != USER2 &&
@@ -1198,11 +1386,13 @@ int restore_game(void) {
 	}
 
 	for (i = 0; i < LIST_SIZE; i++) {
-		obj = &(game.object[i]);
+		obj = PIECE(i + 1);
 		R_RI32(obj->owner);
 		R_RI32(obj->type);
 		R_RI32(obj->loc);
+		obj->loc = restore_loc(obj->loc);
 		R_RI64(obj->func);
+		obj->func = restore_loc(obj->func);
 		R_RI32(obj->hits);
 		R_RI32(obj->moved);
 		R_RI32(obj->count);
@@ -1224,19 +1414,22 @@ int restore_game(void) {
 
 	game.free_list = NULL; /* zero all ptrs */
 	for (i = 0; i < LIST_SIZE; i++) {
-		game.object[i].loc_link.next = NULL;
-		game.object[i].loc_link.prev = NULL;
-		game.object[i].cargo_link.next = NULL;
-		game.object[i].cargo_link.prev = NULL;
-		game.object[i].piece_link.next = NULL;
-		game.object[i].piece_link.prev = NULL;
-		game.object[i].ship = NULL;
-		game.object[i].cargo = NULL;
-	}
-	for (i = 0; i < NUM_OBJECTS; i++) {
-		game.comp_obj[i] = NULL;
-		game.user_obj[i] = NULL;
-	}
+		obj = PIECE(i + 1);
+		obj->loc_link.next = 0;
+		obj->loc_link.prev = 0;
+		obj->cargo_link.next = 0;
+		obj->cargo_link.prev = 0;
+		obj->piece_link.next = 0;
+		obj->piece_link.prev = 0;
+		obj->sector_link.next = 0;
+		obj->sector_link.prev = 0;
+		obj->ship = 0;
+		obj->cargo = NULL;
+	}
+	(void)memset(game.obj_list, 0, sizeof(game.obj_list));
+	(void)memset(game.sector_obj, 0, sizeof(game.sector_obj));
+	(void)memset(game.comp_sight, 0, MAP_SIZE * sizeof(sight_t));
+	(void)memset(game.user_sight, 0, MAP_SIZE * sizeof(sight_t));
 	/* put cities on game.real_map */
 	for (i = 0; i < NUM_CITY; i++) {
 		if (game.city[i].loc < 0 || game.city[i].loc >= MAP_SIZE) {
@@ -1248,9 +1441,8 @@ int restore_game(void) {
 
 	/* put pieces in free list or on map and in object lists */
 	for (i = 0; i < LIST_SIZE; i++) {
-		obj = &(game.object[i]);
-		if (game.object[i].owner == UNOWNED ||
-		    game.object[i].hits == 0) {
+		obj = PIECE(i + 1);
+		if (obj->owner == UNOWNED || obj->hits == 0) {
 			LINK(game.free_list, obj, piece_link);
 		} else {
 			if (obj->loc < 0 || obj->loc >= MAP_SIZE ||
@@ -1259,18 +1451,22 @@ int restore_game(void) {
 				        "Saved file has invalid object data.\n");
 				goto restore_cleanup;
 			}
-			list = LIST(game.object[i].owner);
-			LINK(list[game.object[i].type], obj, piece_link);
-			LINK(game.real_map[game.object[i].loc].objp, obj,
-			     loc_link);
+			list = LIST(obj->owner);
+			LINK(list[obj->type], obj, piece_link);
+			LINK(game.real_map[obj->loc].objp, obj, loc_link);
+			stack_changed(obj->loc);
+			enter_sector(obj);
 		}
 	}
 
 	/* Embark armies and fighters. */
-	read_embark(game.user_obj[TRANSPORT], ARMY);
-	read_embark(game.user_obj[CARRIER], FIGHTER);
-	read_embark(game.comp_obj[TRANSPORT], ARMY);
-	read_embark(game.comp_obj[CARRIER], FIGHTER);
+	for (i = USER; i <= COMP; i++) {
+		read_embark(game.obj_list[i][TRANSPORT], ARMY);
+		read_embark(game.obj_list[i][CARRIER], FIGHTER);
+	}
+	count_pool();
+	index_cities();
+	index_sight();
 
 	(void)fclose(f);
 	kill_display(); /* what we had is no longer good */
@@ -1279,6 +1475,8 @@ int restore_game(void) {
 
 restore_cleanup:
 	(void)fclose(f);
+	(void)set_map_size(old_width, old_height);
+	game.list_size = old_list_size;
 	return (false);
 
 #undef R_RU8
@@ -1299,15 +1497,15 @@ void read_embark(piece_info_t *list, int piece_type) {
 	piece_info_t *ship;
 	piece_info_t *obj;
 
-	for (ship = list; ship != NULL; ship = ship->piece_link.next) {
+	for (ship = list; ship != NULL; ship = NEXT(ship, piece_link)) {
 		int count = ship->count; /* get # of pieces we need */
 		if (count < 0) {
 			inconsistent();
 		}
 		ship->count = 0; /* nothing on board yet */
 		for (obj = game.real_map[ship->loc].objp; obj && count;
-		     obj = obj->loc_link.next) {
-			if (obj->ship == NULL && obj->type == piece_type) {
+		     obj = NEXT(obj, loc_link)) {
+			if (!obj->ship && obj->type == piece_type) {
 				embark(ship, obj);
 				count -= 1;
 			}
@@ -1372,7 +1570,7 @@ computer's screen.  This information is appended to 'empmovie.dat'.
 */
 
 extern char city_char[];
-static char mapbuf[MAP_SIZE];
+/* 'mapbuf' holds a frame, numbered as in save files */
 
 void save_movie_screen(void) {
 	FILE *f; /* file to save game in */
@@ -1385,14 +1583,16 @@ void save_movie_screen(void) {
 		return;
 	}
 
-	for (i = 0; i < MAP_SIZE; i++) {
-		if (game.real_map[i].cityp) {
-			mapbuf[i] = city_char[game.real_map[i].cityp->owner];
+	for (i = 0; i < MAP_CELLS; i++) {
+		loc_t loc = cell_loc(i);
+
+		if (game.real_map[loc].cityp) {
+			mapbuf[i] = city_char[game.real_map[loc].cityp->owner];
 		} else {
-			p = find_obj_at_loc(i);
+			p = find_obj_at_loc(loc);
 
 			if (!p) {
-				mapbuf[i] = game.real_map[i].contents;
+				mapbuf[i] = game.real_map[loc].contents;
 			} else if (p->owner == USER) {
 				mapbuf[i] = piece_attr[p->type].sname;
 			} else {
@@ -1400,7 +1600,9 @@ void save_movie_screen(void) {
 			}
 		}
 	}
-	wbuf(mapbuf);
+	if (!xwrite(f, mapbuf, MAP_CELLS)) {
+		return;
+	}
 	(void)fclose(f);
 }
 
@@ -1425,8 +1627,7 @@ void replay_movie(void) {
 	clear_screen();
 	for (;;) {
 		int row_inc, col_inc;
-		if (fread((char *)mapbuf, 1, sizeof(mapbuf), f) !=
-		    sizeof(mapbuf)) {
+		if (fread((char *)mapbuf, 1, MAP_CELLS, f) != MAP_CELLS) {
 			break;
 		}
 		round += 1;
@@ -1471,7 +1672,7 @@ void stat_display(char *mbuf, int round) {
 
 	(void)memset((char *)counts, '\0', sizeof(counts));
 
-	for (i = 0; i < MAP_SIZE; i++) {
+	for (i = 0; i < MAP_CELLS; i++) {
 		char *p = strchr(pieces, mbuf[i]);
 		if (p) {
 			counts[p - pieces] += 1;
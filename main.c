@@ -27,6 +27,17 @@ options:
     
     -a ai_mask: bitmask for AI players (e.g., 1010 for P2 and P4 as AI).
                 Default is 0000 (all human).
+
+    -j threads: number of threads planning the computer's moves.
+               Default is 1.  The game plays out the same either way.
+               Only the classic computer player plans; the AI seats
+               chosen by -a or --sim move without planning.
+
+    -W width:  width of the map.  Must be in the range 40..500.
+               Default is 100.
+
+    -H height: height of the map.  Must be in the range 24..300.
+               Default is 60.  A restored game keeps its own size.
 */
 
 #include "empire.h"
@@ -36,14 +47,14 @@ options:
 #include <string.h>
 #include <unistd.h>
 
-#define OPTFLAGS "w:s:d:S:f:p:b"
+#define OPTFLAGS "w:s:d:S:f:p:bj:W:H:"
 
 int main(int argc, char *argv[]) {
 	int c;
 	extern char *optarg;
 	extern int optind;
 	int errflg = 0;
-	int wflg, sflg, dflg, Sflg, pflg;
+	int wflg, sflg, dflg, Sflg, pflg, jflg, Wflg, Hflg;
 	int land;
 	int i, j;
 	int bflg = 0; /* box map flag */
@@ -54,6 +65,9 @@ int main(int argc, char *argv[]) {
 	dflg = 2000;
 	Sflg = 10;
 	pflg = 2; /* default to 2 players for hotseat */
+	jflg = 1;
+	Wflg = DEF_MAP_WIDTH;
+	Hflg = DEF_MAP_HEIGHT;
 	game.savefile = "empire.sav";
 	game.ai_mask = 0; /* default: all human players */
 	game.sim_mode = false; /* default: human plays */
@@ -109,6 +123,15 @@ int main(int argc, char *argv[]) {
 		case 'b':
 			bflg = 1;
 			break;
+		case 'j':
+			jflg = atoi(optarg);
+			break;
+		case 'W':
+			Wflg = atoi(optarg);
+			break;
+		case 'H':
+			Hflg = atoi(optarg);
+			break;
 		case '?': /* illegal option? */
 			errflg++;
 			break;
@@ -116,7 +139,8 @@ int main(int argc, char *argv[]) {
 	}
 	if (errflg || (argc - optind) != 0) {
 		(void)printf("empire: usage: empire [-w water] [-s smooth] [-d "
-		             "delay] [-p players] [-f savefile] [-b] [--sim] [--text]\n");
+		             "delay] [-p players] [-f savefile] [-j threads] [-b] "
+		             "[-W width] [-H height] [--sim] [--text]\n");
 		(void)printf("  --sim: simulation mode - AI controls all units\n");
 		(void)printf("  -b: box map mode - simple rectangular land mass\n");
 		(void)printf("  --text: print map as text (+ for land, . for sea, o for cities) and exit\n");
@@ -146,12 +170,26 @@ int main(int argc, char *argv[]) {
 		exit(1);
 	}
 
+	if (jflg < 1 || jflg > MAX_PLAN_THREADS) {
+		(void)printf("empire: -j argument must be in the range 1..%d.\n",
+		             MAX_PLAN_THREADS);
+		exit(1);
+	}
+
+	if (!set_map_size(Wflg, Hflg)) {
+		(void)printf("empire: map must be from %dx%d to %dx%d.\n",
+		             MIN_MAP_WIDTH, MIN_MAP_HEIGHT, MAX_MAP_WIDTH,
+		             MAX_MAP_HEIGHT);
+		exit(1);
+	}
+
 	game.SMOOTH = sflg;
 	game.WATER_RATIO = wflg;
 	game.delay_time = dflg;
 	game.save_interval = Sflg;
 	game.num_players = pflg;
 	game.box_map = bflg;
+	game.plan_threads = jflg;
 
 	/* Set default savefile based on player count if not specified */
 	if (game.savefile == NULL || strcmp(game.savefile, "empire.sav") == 0) {
@@ -172,7 +210,7 @@ int main(int argc, char *argv[]) {
 	}
 
 	/* compute min distance between cities */
-	land = MAP_SIZE * (100 - game.WATER_RATIO) / 100; /* available land */
+	land = MAP_CELLS * (100 - game.WATER_RATIO) / 100; /* available land */
 	land /= NUM_CITY; /* land per city */
 	game.MIN_CITY_DIST = isqrt(land); /* distance between cities */
 
@@ -15,6 +15,7 @@ real maps, path_maps, and cont_maps.
 
 #include "empire.h"
 #include "extern.h"
+#include <stdlib.h>
 #include <string.h>
 
 #define SWAP(a, b)                                                             \
@@ -25,25 +26,44 @@ real maps, path_maps, and cont_maps.
 		b = x;                                                         \
 	}
 
-static void expand_perimeter(path_map_t *, view_map_t *, move_info_t *,
-                             perimeter_t *, int, int, int, int, perimeter_t *,
-                             perimeter_t *);
+static void expand_perimeter(path_ctx_t *, path_map_t *, view_map_t *,
+                             move_info_t *, perimeter_t *, int, int, int, int,
+                             perimeter_t *, perimeter_t *);
 static void expand_prune(view_map_t *, path_map_t *, loc_t, int, perimeter_t *,
-                         int *);
+                         long *);
 static int objective_cost(view_map_t *, move_info_t *, loc_t, int);
 static int terrain_type(path_map_t *, view_map_t *, move_info_t *, loc_t,
                         loc_t);
-static void start_perimeter(path_map_t *, perimeter_t *, loc_t, int);
+static void start_path_map(path_ctx_t *, path_map_t *, loc_t, int);
+static void start_perimeter(path_ctx_t *, path_map_t *, perimeter_t *, loc_t,
+                            int);
 static void add_cell(path_map_t *, loc_t, perimeter_t *, int, int, int);
+static void claim_cell(path_map_t *, loc_t);
+static loc_t find_dest(path_ctx_t *, path_map_t *, view_map_t *, loc_t, loc_t,
+                       int, int);
+static void expand_dest_cell(path_ctx_t *, path_map_t *, view_map_t *,
+                             move_info_t *, loc_t, loc_t, int, perimeter_t **,
+                             int);
 static int vmap_count_path(path_map_t *, loc_t);
+static loc_t bit_find_xobj(path_ctx_t *, path_map_t *, view_map_t *, loc_t,
+                           move_info_t *, int, int, int);
+static int loc_cluster(loc_t);
+static bool in_box(path_ctx_t *, loc_t);
+static loc_t route_waypoint(path_ctx_t *, view_map_t *, loc_t, loc_t, int,
+                            int);
 
-static perimeter_t p1; /* perimeter list for use as needed */
-static perimeter_t p2;
-static perimeter_t p3;
-static perimeter_t p4;
+/*
+Every change noted by 'vmap_changed' goes into a ring.  Anything
+worked out from a view map can remember the change clock, and later
+look at just the cells changed since, as long as there have not been
+more than CHANGE_RING of them.  Planning threads read the ring while
+the main thread waits (see 'make_plans'); only the main thread writes.
+*/
 
-static int best_cost; /* cost and location of best objective */
-static loc_t best_loc;
+#define CHANGE_RING 4096
+
+static loc_t change_ring[CHANGE_RING];
+static unsigned long change_clock; /* changes noted so far */
 
 /*
 Map out a continent.  We are given a location on the continent.
@@ -53,9 +73,10 @@ territory adjacent to the continent.  By adjusting the value of
 or lakes.
 */
 
-void vmap_cont(int *cont_map, view_map_t *vmap, loc_t loc, char bad_terrain) {
+void vmap_cont(path_ctx_t *ctx, int *cont_map, view_map_t *vmap, loc_t loc,
+               char bad_terrain) {
 	(void)memset((char *)cont_map, '\0', MAP_SIZE * sizeof(int));
-	vmap_mark_up_cont(cont_map, vmap, loc, bad_terrain);
+	vmap_mark_up_cont(ctx, cont_map, vmap, loc, bad_terrain);
 }
 
 /*
@@ -64,15 +85,15 @@ to the continent which are on the board.  Our passed location is
 known to be either on the continent or adjacent to the continent.
 */
 
-void vmap_mark_up_cont(int *cont_map, view_map_t *vmap, loc_t loc,
-                       char bad_terrain) {
+void vmap_mark_up_cont(path_ctx_t *ctx, int *cont_map, view_map_t *vmap,
+                       loc_t loc, char bad_terrain) {
 	int i, j;
 	loc_t new_loc;
 	char this_terrain;
 	perimeter_t *from, *to;
 
-	from = &p1;
-	to = &p2;
+	from = &ctx->perim[0];
+	to = &ctx->perim[1];
 
 	from->len = 1; /* init perimeter */
 	from->list[0] = loc;
@@ -156,17 +177,69 @@ static void rmap_mark_up_cont(int *cont_map, loc_t loc, char bad_terrain) {
 	rmap_mark_up_cont(cont_map, new_loc, bad_terrain);
 }
 
-/*
-Scan a continent recording items of interest on the continent.
-
-This could be done as we mark up the continent.
-*/
-
 #define COUNT(c, item)                                                         \
 	case c:                                                                \
-		item += 1;                                                     \
+		item += delta;                                                 \
 		break
 
+/*
+Add 'delta' to the count a cell falls under.  'contents' is what the
+view map shows at 'loc', and 'owner' is the owner of any city there.
+*/
+
+static void count_cell(scan_counts_t *counts, char contents, loc_t loc,
+                       int owner, int delta) {
+	switch (contents) {
+		COUNT(' ', counts->unexplored);
+		COUNT('O', counts->user_cities);
+		COUNT('A', counts->user_objects[ARMY]);
+		COUNT('F', counts->user_objects[FIGHTER]);
+		COUNT('P', counts->user_objects[PATROL]);
+		COUNT('D', counts->user_objects[DESTROYER]);
+		COUNT('S', counts->user_objects[SUBMARINE]);
+		COUNT('T', counts->user_objects[TRANSPORT]);
+		COUNT('C', counts->user_objects[CARRIER]);
+		COUNT('B', counts->user_objects[BATTLESHIP]);
+		COUNT('X', counts->comp_cities);
+		COUNT('a', counts->comp_objects[ARMY]);
+		COUNT('f', counts->comp_objects[FIGHTER]);
+		COUNT('p', counts->comp_objects[PATROL]);
+		COUNT('d', counts->comp_objects[DESTROYER]);
+		COUNT('s', counts->comp_objects[SUBMARINE]);
+		COUNT('t', counts->comp_objects[TRANSPORT]);
+		COUNT('c', counts->comp_objects[CARRIER]);
+		COUNT('b', counts->comp_objects[BATTLESHIP]);
+		COUNT(MAP_CITY, counts->unowned_cities);
+	case MAP_LAND:
+		break;
+	case MAP_SEA:
+		break;
+	default: /* check for city underneath */
+		if (game.real_map[loc].contents == MAP_CITY) {
+			switch (owner) {
+				COUNT(USER, counts->user_cities);
+				COUNT(COMP, counts->comp_cities);
+				COUNT(UNOWNED, counts->unowned_cities);
+			}
+		}
+	}
+}
+
+/* Return the owner of any city at a location. */
+
+static int cell_owner(loc_t loc) {
+	if (game.real_map[loc].cityp == NULL) {
+		return UNOWNED;
+	}
+	return game.real_map[loc].cityp->owner;
+}
+
+/*
+Scan a continent recording items of interest on the continent.
+Labelling every continent at once (see 'vmap_cont_counts') is
+cheaper when several continents are wanted.
+*/
+
 scan_counts_t vmap_cont_scan(int *cont_map, view_map_t *vmap) {
 	scan_counts_t counts;
 	count_t i;
@@ -176,42 +249,8 @@ scan_counts_t vmap_cont_scan(int *cont_map, view_map_t *vmap) {
 	for (i = 0; i < MAP_SIZE; i++) {
 		if (cont_map[i]) { /* cell on continent? */
 			counts.size += 1;
-
-			switch (vmap[i].contents) {
-				COUNT(' ', counts.unexplored);
-				COUNT('O', counts.user_cities);
-				COUNT('A', counts.user_objects[ARMY]);
-				COUNT('F', counts.user_objects[FIGHTER]);
-				COUNT('P', counts.user_objects[PATROL]);
-				COUNT('D', counts.user_objects[DESTROYER]);
-				COUNT('S', counts.user_objects[SUBMARINE]);
-				COUNT('T', counts.user_objects[TRANSPORT]);
-				COUNT('C', counts.user_objects[CARRIER]);
-				COUNT('B', counts.user_objects[BATTLESHIP]);
-				COUNT('X', counts.comp_cities);
-				COUNT('a', counts.comp_objects[ARMY]);
-				COUNT('f', counts.comp_objects[FIGHTER]);
-				COUNT('p', counts.comp_objects[PATROL]);
-				COUNT('d', counts.comp_objects[DESTROYER]);
-				COUNT('s', counts.comp_objects[SUBMARINE]);
-				COUNT('t', counts.comp_objects[TRANSPORT]);
-				COUNT('c', counts.comp_objects[CARRIER]);
-				COUNT('b', counts.comp_objects[BATTLESHIP]);
-				COUNT(MAP_CITY, counts.unowned_cities);
-			case MAP_LAND:
-				break;
-			case MAP_SEA:
-				break;
-			default: /* check for city underneath */
-				if (game.real_map[i].contents == MAP_CITY) {
-					switch (game.real_map[i].cityp->owner) {
-						COUNT(USER, counts.user_cities);
-						COUNT(COMP, counts.comp_cities);
-						COUNT(UNOWNED,
-						      counts.unowned_cities);
-					}
-				}
-			}
+			count_cell(&counts, vmap[i].contents, i, cell_owner(i),
+			           1);
 		}
 	}
 	return counts;
@@ -257,267 +296,1185 @@ bool map_cont_edge(const int *cont_map, loc_t loc) {
 }
 
 /*
-Find the nearest objective for a piece.  This routine actually does
-some real work.  This code represents my fourth rewrite of the
-algorithm.  This algorithm is central to the strategy used by the
-computer.
-
-Given a view_map, we create a path_map.  On the path_map, we record
-the distance from a location to the nearest objective.  We are
-given information about what the interesting objectives are, and
-how interesting each objective is.
+Label every continent of a view map at once.  A continent is what
+'vmap_cont' would map out from any of its cells: a connected set of
+explored cells whose terrain is not 'bad_terrain', with the unexplored
+cells next to it.  An unexplored cell may border, and so belong to,
+several continents.
+
+Labels are made with a union-find pass over the map, and the counts
+'vmap_cont_scan' would give are kept for each continent.  The view map
+may then change under the labels.  A change that only alters what a
+cell holds is patched into the counts.  When an unexplored cell is
+revealed we take it off the continents it bordered, and if it turns
+out to be on a continent we join the continents around it, relabelling
+the cells of the smaller one.  Any other change to which cells are on
+a continent makes us label the map again.
+*/
 
-We use a breadth first search to find the nearest objective.
-We maintain something called a "perimeter list".  This list
-initially contains a list of squares that we can reach in 'n' moves.
-On each pass through our loop, we add all squares that are adjacent
-to the perimeter list and which lie outside the perimeter to our
-list.  (The loop is only slightly more complicated for armies and
-transports.)
+#define CONT_OFF 0  /* cell is not on a continent */
+#define CONT_EDGE 1 /* unexplored cell next to continents */
+#define CONT_ON 2   /* cell is on a continent */
+
+/* Main thread only, like the route graphs and 'prune_pmap'. */
+static int *cont_root;              /* union-find forest */
+static unsigned long *cont_mark;    /* cells seen in a join */
+static unsigned long cont_mark_gen; /* mark of the current join */
+
+/* Make room in a set of labels for the current map; it is left empty. */
+
+void size_cont_labels(cont_labels_t *cl) {
+	RESIZE(cl->label, MAP_SIZE);
+	RESIZE(cl->seen, MAP_SIZE);
+	RESIZE(cl->owner, MAP_SIZE);
+	RESIZE(cl->next, MAP_SIZE);
+	RESIZE(cl->first, NUM_CONTS);
+	RESIZE(cl->free_conts, NUM_CONTS);
+	RESIZE(cl->counts, NUM_CONTS);
+	cl->vmap = NULL;
+	cl->set_len = 0;
+}
 
-When our perimeter list becomes empty, or when the distance to
-the current perimeter is at least as large as the weighted distance
-to the best objective, we return the location of the best objective
-found.
+/* Return how a cell showing 'contents' lies with respect to continents. */
 
-The 'cost' field in a path_map must be INFINITY if the cell lies
-outside of the current perimeter.  The cost for cells that lie
-on or within the current perimeter doesn't matter, except that
-the information must be consistent with the needs of 'vmap_mark_path'.
-*/
+static int cont_class(char contents, loc_t loc, char bad_terrain) {
+	char terrain;
 
-/* Find an objective over a single type of terrain. */
+	if (contents == ' ') {
+		return CONT_EDGE;
+	}
+	if (contents == MAP_LAND || contents == MAP_SEA) {
+		terrain = contents;
+	} else {
+		terrain = game.real_map[loc].contents;
+	}
+	return terrain == bad_terrain ? CONT_OFF : CONT_ON;
+}
 
-loc_t vmap_find_xobj(path_map_t path_map[], view_map_t *vmap, loc_t loc,
-                     move_info_t *move_info, int start, int expand) {
-	perimeter_t *from;
-	perimeter_t *to;
-	int cur_cost;
+/* Find the root of a cell's tree, halving the path as we go. */
 
-	from = &p1;
-	to = &p2;
+static int cont_find(int loc) {
+	while (cont_root[loc] != loc) {
+		cont_root[loc] = cont_root[cont_root[loc]];
+		loc = cont_root[loc];
+	}
+	return loc;
+}
 
-	start_perimeter(path_map, from, loc, start);
-	cur_cost = 0; /* cost to reach current perimeter */
+/*
+List the different continents next to a cell, leaving out the cell
+'skip'.  We return the number of continents listed.
+*/
 
-	for (;;) {
-		to->len = 0; /* nothing in perim yet */
-		expand_perimeter(path_map, vmap, move_info, from, expand,
-		                 cur_cost, 1, 1, to, to);
+static int cont_around(cont_labels_t *cl, loc_t loc, loc_t skip,
+                       int *conts) {
+	loc_t new_loc;
+	int i, k, n;
 
-		if (game.trace_pmap) {
-			print_pzoom("After xobj loop:", path_map, vmap);
+	n = 0;
+	FOR_ADJ_ON(loc, new_loc, i) {
+		if (new_loc == skip || cl->label[new_loc] < 0) {
+			continue;
 		}
-
-		cur_cost += 1;
-		if (to->len == 0 || best_cost <= cur_cost) {
-			return best_loc;
+		for (k = 0; k < n && conts[k] != cl->label[new_loc]; k++) {
+			;
+		}
+		if (k == n) {
+			conts[n++] = cl->label[new_loc];
 		}
-
-		SWAP(from, to);
 	}
+	return n;
 }
 
-/* Find an objective for a piece that crosses land and water. */
+/* Hand out an unused continent number. */
 
-loc_t vmap_find_aobj(path_map_t path_map[], view_map_t *vmap, loc_t loc,
-                     move_info_t *move_info) {
-	return vmap_find_xobj(path_map, vmap, loc, move_info, T_LAND, T_AIR);
+static int cont_new(cont_labels_t *cl) {
+	int cont;
+
+	if (cl->num_free > 0) {
+		cont = cl->free_conts[--cl->num_free];
+	} else {
+		ASSERT(cl->num_conts < NUM_CONTS);
+		cont = cl->num_conts++;
+	}
+	cl->first[cont] = -1;
+	(void)memset((char *)&cl->counts[cont], '\0', sizeof(scan_counts_t));
+	return cont;
 }
 
-/* Find an objective for a piece that crosses only water. */
+/* Put an explored cell on a continent. */
 
-loc_t vmap_find_wobj(path_map_t path_map[], view_map_t *vmap, loc_t loc,
-                     move_info_t *move_info) {
-	return vmap_find_xobj(path_map, vmap, loc, move_info, T_WATER, T_WATER);
+static void cont_add(cont_labels_t *cl, loc_t loc, int cont) {
+	cl->label[loc] = cont;
+	cl->next[loc] = cl->first[cont];
+	cl->first[cont] = loc;
+	cl->counts[cont].size += 1;
+	count_cell(&cl->counts[cont], cl->seen[loc], loc, cl->owner[loc], 1);
 }
 
-/* Find an objective for a piece that crosses only land. */
+/* Label the map from scratch. */
+
+static void cont_label_all(cont_labels_t *cl) {
+	view_map_t *vmap = cl->vmap;
+	loc_t loc, new_loc;
+	int i, k, n, root;
+	int conts[8]; /* continents next to an unexplored cell */
 
-loc_t vmap_find_lobj(path_map_t path_map[], view_map_t *vmap, loc_t loc,
-                     move_info_t *move_info) {
-	return vmap_find_xobj(path_map, vmap, loc, move_info, T_LAND, T_LAND);
+	for (loc = 0; loc < MAP_SIZE; loc++) {
+		cont_root[loc] = loc;
+		cl->label[loc] = -1;
+		cl->seen[loc] = vmap[loc].contents;
+		cl->owner[loc] = cell_owner(loc);
+	}
+	/* join each continent cell to the continent cells before it */
+	for (loc = 0; loc < MAP_SIZE; loc++) {
+		if (!game.real_map[loc].on_board ||
+		    cont_class(cl->seen[loc], loc, cl->bad_terrain) !=
+		        CONT_ON) {
+			continue;
+		}
+		FOR_ADJ_ON(loc, new_loc, i) {
+			if (new_loc < loc &&
+			    cont_class(cl->seen[new_loc], new_loc,
+			               cl->bad_terrain) == CONT_ON) {
+				root = cont_find(new_loc);
+				if (root != cont_find(loc)) {
+					cont_root[root] = cont_find(loc);
+				}
+			}
+		}
+	}
+	/* number the continents and count their cells */
+	cl->num_conts = 0;
+	cl->num_free = 0;
+	for (loc = 0; loc < MAP_SIZE; loc++) {
+		if (!game.real_map[loc].on_board ||
+		    cont_class(cl->seen[loc], loc, cl->bad_terrain) !=
+		        CONT_ON) {
+			continue;
+		}
+		root = cont_find(loc);
+		if (cl->label[root] < 0) {
+			cl->label[root] = cont_new(cl);
+		}
+		cont_add(cl, loc, cl->label[root]);
+	}
+	/* add each unexplored cell to the continents it borders */
+	for (loc = 0; loc < MAP_SIZE; loc++) {
+		if (!game.real_map[loc].on_board || cl->seen[loc] != ' ') {
+			continue;
+		}
+		n = cont_around(cl, loc, -1, conts);
+		for (k = 0; k < n; k++) {
+			cl->counts[conts[k]].size += 1;
+			cl->counts[conts[k]].unexplored += 1;
+		}
+	}
+	cl->set_len = 0;
+	cl->synced = change_clock;
 }
 
 /*
-Find an objective moving from land to water.
-This is mildly complicated.  It costs 2 to move on land
-and one to move on water.  To handle this, we expand our current
-perimeter by one cell, where land can be expanded to either
-land or water, and water is only expanded to water.  Then
-we expand any water one more cell.
-
-We have different objectives depending on whether the objective
-is being approached from the land or the water.
+Return true if a cell lies next to a continent, not counting the
+cell 'skip'.
 */
 
-loc_t vmap_find_lwobj(path_map_t path_map[], view_map_t *vmap, loc_t loc,
-                      move_info_t *move_info, int beat_cost) {
-	perimeter_t *cur_land;
-	perimeter_t *cur_water;
-	perimeter_t *new_land;
-	perimeter_t *new_water;
-	int cur_cost;
+static bool cont_borders(cont_labels_t *cl, loc_t loc, int cont,
+                         loc_t skip) {
+	loc_t new_loc;
+	int i;
+
+	FOR_ADJ_ON(loc, new_loc, i) {
+		if (new_loc != skip && cl->label[new_loc] == cont) {
+			return true;
+		}
+	}
+	return false;
+}
 
-	cur_land = &p1;
-	cur_water = &p2;
-	new_water = &p3;
-	new_land = &p4;
+/*
+Join two continents, returning the number of the joined continent.  An
+unexplored cell next to both was counted in each, so we take it out
+once.
+*/
 
-	start_perimeter(path_map, cur_land, loc, T_LAND);
-	cur_water->len = 0;
-	best_cost = beat_cost; /* we can do this well */
-	cur_cost = 0;          /* cost to reach current perimeter */
+static int cont_join(cont_labels_t *cl, int a, int b) {
+	loc_t loc, new_loc, last;
+	int i, t, dup;
+	scan_counts_t *pa, *pb;
 
-	for (;;) {
-		/* expand current perimeter one cell */
-		new_water->len = 0;
-		new_land->len = 0;
-		expand_perimeter(path_map, vmap, move_info, cur_water, T_WATER,
-		                 cur_cost, 1, 1, new_water, NULL);
+	if (cl->counts[a].size < cl->counts[b].size) {
+		t = a; /* relabel the smaller continent */
+		a = b;
+		b = t;
+	}
+	cont_mark_gen++;
+	dup = 0;
+	last = -1;
+	for (loc = cl->first[b]; loc >= 0; loc = cl->next[loc]) {
+		FOR_ADJ_ON(loc, new_loc, i) {
+			if (cl->seen[new_loc] == ' ' &&
+			    cont_mark[new_loc] != cont_mark_gen) {
+				cont_mark[new_loc] = cont_mark_gen;
+				if (cont_borders(cl, new_loc, a, -1)) {
+					dup++;
+				}
+			}
+		}
+		last = loc;
+	}
+	for (loc = cl->first[b]; loc >= 0; loc = cl->next[loc]) {
+		cl->label[loc] = a;
+	}
+	cl->next[last] = cl->first[a];
+	cl->first[a] = cl->first[b];
+
+	pa = &cl->counts[a];
+	pb = &cl->counts[b];
+	pa->user_cities += pb->user_cities;
+	pa->comp_cities += pb->comp_cities;
+	for (i = 0; i < NUM_OBJECTS; i++) {
+		pa->user_objects[i] += pb->user_objects[i];
+		pa->comp_objects[i] += pb->comp_objects[i];
+	}
+	pa->size += pb->size;
+	pa->unowned_cities += pb->unowned_cities;
+	pa->unexplored += pb->unexplored;
+	cl->counts[a].size -= dup;
+	cl->counts[a].unexplored -= dup;
+	cl->free_conts[cl->num_free++] = b;
+	return a;
+}
 
-		expand_perimeter(path_map, vmap, move_info, cur_land, T_AIR,
-		                 cur_cost, 1, 2, new_water, new_land);
+/*
+Patch the labels for an unexplored cell that has been revealed to
+hold 'contents'.
+*/
 
-		/* expand new water one cell */
-		cur_water->len = 0;
-		expand_perimeter(path_map, vmap, move_info, new_water, T_WATER,
-		                 cur_cost + 1, 1, 1, cur_water, NULL);
+static void cont_reveal(cont_labels_t *cl, loc_t loc, char contents,
+                        int owner) {
+	loc_t new_loc;
+	int i, k, n, cont;
+	int conts[8]; /* continents next to the cell */
+
+	/* take the cell off the continents it bordered */
+	n = cont_around(cl, loc, -1, conts);
+	for (k = 0; k < n; k++) {
+		cl->counts[conts[k]].size -= 1;
+		cl->counts[conts[k]].unexplored -= 1;
+	}
+	cl->seen[loc] = contents;
+	cl->owner[loc] = owner;
+	if (cont_class(contents, loc, cl->bad_terrain) == CONT_OFF) {
+		return;
+	}
+	/* join the continents around the cell and put it on the result */
+	cont = n > 0 ? conts[0] : cont_new(cl);
+	for (k = 1; k < n; k++) {
+		cont = cont_join(cl, cont, conts[k]);
+	}
+	cont_add(cl, loc, cont);
 
-		if (game.trace_pmap) {
-			print_pzoom("After lwobj loop:", path_map, vmap);
+	/* unexplored cells next to the cell now border the continent */
+	FOR_ADJ_ON(loc, new_loc, i) {
+		if (cl->seen[new_loc] == ' ' &&
+		    !cont_borders(cl, new_loc, cont, loc)) {
+			cl->counts[cont].size += 1;
+			cl->counts[cont].unexplored += 1;
 		}
+	}
+}
 
-		cur_cost += 2;
-		if ((cur_water->len == 0 && new_land->len == 0) ||
-		    (best_cost <= cur_cost)) {
-			return best_loc;
-		}
+/*
+Bring the counts for a cell up to date with what the view map now
+shows there.  We return false if we cannot patch the labels for the
+change, in which case they are no good.
+*/
 
-		SWAP(cur_land, new_land);
+static bool cont_recount(cont_labels_t *cl, loc_t loc) {
+	char contents = cl->vmap[loc].contents;
+	int owner = cell_owner(loc);
+	int old_class = cont_class(cl->seen[loc], loc, cl->bad_terrain);
+
+	if (cont_class(contents, loc, cl->bad_terrain) == old_class) {
+		if (cl->label[loc] >= 0) {
+			count_cell(&cl->counts[cl->label[loc]], cl->seen[loc],
+			           loc, cl->owner[loc], -1);
+			count_cell(&cl->counts[cl->label[loc]], contents, loc,
+			           owner, 1);
+		}
+		cl->seen[loc] = contents;
+		cl->owner[loc] = owner;
+		return true;
+	}
+	if (old_class == CONT_EDGE && game.real_map[loc].on_board) {
+		cont_reveal(cl, loc, contents, owner);
+		return true;
 	}
+	return false;
 }
 
-#ifdef __UNUSED__
 /*
-Return the cost to reach the adjacent cell of the correct type
-with the lowest cost.
+Bring the labels up to date, labelling the map again if they are for
+some other map or if we cannot patch them.
 */
 
-static int best_adj(path_map_t *pmap, loc_t loc, int type) {
+static void cont_sync(cont_labels_t *cl, view_map_t *vmap, char bad_terrain) {
+	unsigned long n;
 	int i;
-	loc_t new_loc;
-	int best;
-
-	best = INFINITY;
 
-	FOR_ADJ(loc, new_loc, i)
-	if (pmap[new_loc].terrain == type && pmap[new_loc].cost < best) {
-		best = pmap[new_loc].cost;
+	if (cl->vmap != vmap || cl->bad_terrain != bad_terrain ||
+	    change_clock - cl->synced > CHANGE_RING) {
+		cl->vmap = vmap;
+		cl->bad_terrain = bad_terrain;
+		cont_label_all(cl);
+		return;
 	}
-
-	return best;
+	for (n = cl->synced; n != change_clock; n++) {
+		if (!cont_recount(cl, change_ring[n % CHANGE_RING])) {
+			cont_label_all(cl);
+			return;
+		}
+	}
+	for (i = 0; i < cl->set_len; i++) {
+		if (!cont_recount(cl, cl->set[i])) {
+			cont_label_all(cl);
+			return;
+		}
+	}
+	cl->set_len = 0;
+	cl->synced = change_clock;
 }
-#endif
 
 /*
-Find an objective moving from water to land.
-Here, we expand water to either land or water.
-We expand land only to land.
+Return the counts for the continent holding a location, as
+'vmap_cont_scan' would give them after 'vmap_cont'.  The location must
+be on a continent.  The labels stay good while the view map changes
+through 'update' and friends; cells changed any other way must be
+noted (see 'vmap_cont_note'), or the labels forgotten.
+*/
 
-We cheat ever so slightly, but this cheating accurately reflects
-the mechanics o moving.  The first time we expand water we can
-expand to land or water (army moving off tt or tt moving on water),
-but the second time, we only expand water (tt taking its second move).
+scan_counts_t *vmap_cont_counts(cont_labels_t *cl, view_map_t *vmap,
+                                loc_t loc, char bad_terrain) {
+	cont_sync(cl, vmap, bad_terrain);
+	ASSERT(cl->label[loc] >= 0);
+	return &cl->counts[cl->label[loc]];
+}
+
+/*
+Return a number naming the continent holding a location, or -1 if
+the location is not on a continent or is unexplored.
 */
 
-loc_t vmap_find_wlobj(path_map_t path_map[], view_map_t *vmap, loc_t loc,
-                      move_info_t *move_info) {
-	perimeter_t *cur_land;
-	perimeter_t *cur_water;
-	perimeter_t *new_land;
-	perimeter_t *new_water;
-	int cur_cost;
+int vmap_cont_id(cont_labels_t *cl, view_map_t *vmap, loc_t loc,
+                 char bad_terrain) {
+	cont_sync(cl, vmap, bad_terrain);
+	return cl->label[loc];
+}
+
+/*
+Note that a cell of a labelled map has been set other than through
+'update', and patch the counts for it.  The cell is looked at again
+the next time the labels are used, in case the map has been filled in
+afresh by then.
+*/
 
-	cur_land = &p1;
-	cur_water = &p2;
-	new_water = &p3;
-	new_land = &p4;
+void vmap_cont_note(cont_labels_t *cl, loc_t loc) {
+	ASSERT(cl->vmap != NULL);
+	if (cl->set_len == CONT_SETS || !cont_recount(cl, loc)) {
+		cl->vmap = NULL; /* label again when next used */
+		return;
+	}
+	cl->set[cl->set_len++] = loc;
+}
 
-	start_perimeter(path_map, cur_water, loc, T_WATER);
-	cur_land->len = 0;
-	cur_cost = 0; /* cost to reach current perimeter */
+/* Note that a labelled map has been filled in afresh. */
 
-	for (;;) {
-		/* expand current perimeter one cell */
-		new_water->len = 0;
-		new_land->len = 0;
-		expand_perimeter(path_map, vmap, move_info, cur_water, T_AIR,
-		                 cur_cost, 1, 2, new_water, new_land);
+void vmap_cont_forget(cont_labels_t *cl) { cl->vmap = NULL; }
 
-		expand_perimeter(path_map, vmap, move_info, cur_land, T_LAND,
-		                 cur_cost, 1, 2, NULL, new_land);
+/*
+Note that a labelled map has been filled in afresh, much as it was
+before.  We look for the cells that differ from what we counted and
+patch the labels for them, so the continents are only labelled again
+if their shape has changed in a way we cannot patch.
+*/
 
-		/* expand new water one cell to water */
-		cur_water->len = 0;
-		expand_perimeter(path_map, vmap, move_info, new_water, T_WATER,
-		                 cur_cost + 1, 1, 1, cur_water, NULL);
+void vmap_cont_refresh(cont_labels_t *cl) {
+	loc_t loc;
 
-		if (game.trace_pmap) {
-			print_pzoom("After wlobj loop:", path_map, vmap);
+	if (cl->vmap == NULL) {
+		return; /* nothing labelled */
+	}
+	for (loc = 0; loc < MAP_SIZE; loc++) {
+		if (cl->vmap[loc].contents != cl->seen[loc] ||
+		    cell_owner(loc) != cl->owner[loc]) {
+			if (!cont_recount(cl, loc)) {
+				cont_label_all(cl);
+				return;
+			}
 		}
+	}
+	cl->set_len = 0;
+	cl->synced = change_clock;
+}
+
+/*
+Note that the listed cells of a labelled map may have been changed
+other than through 'update', and patch the labels for them.
+*/
 
-		cur_cost += 2;
-		if ((cur_water->len == 0 && new_land->len == 0) ||
-		    (best_cost <= cur_cost)) {
-			return best_loc;
+void vmap_cont_recheck(cont_labels_t *cl, perimeter_t *cells) {
+	loc_t loc;
+	long i;
+
+	if (cl->vmap == NULL) {
+		return; /* nothing labelled */
+	}
+	for (i = 0; i < cells->len; i++) {
+		loc = cells->list[i];
+		if (cl->vmap[loc].contents != cl->seen[loc] &&
+		    !cont_recount(cl, loc)) {
+			cl->vmap = NULL; /* label again when next used */
+			return;
 		}
-		SWAP(cur_land, new_land);
 	}
 }
 
 /*
-Initialize the perimeter searching.
+Find the nearest objective for a piece.  This routine actually does
+some real work.  This code represents my fourth rewrite of the
+algorithm.  This algorithm is central to the strategy used by the
+computer.
 
-This routine was taking a significant amount of the program time (10%)
-doing the initialization of the path map.  We now use an external
-constant and 'memcpy'.
+Given a view_map, we create a path_map.  On the path_map, we record
+the distance from a location to the nearest objective.  We are
+given information about what the interesting objectives are, and
+how interesting each objective is.
+
+We use a breadth first search to find the nearest objective.
+We maintain something called a "perimeter list".  This list
+initially contains a list of squares that we can reach in 'n' moves.
+On each pass through our loop, we add all squares that are adjacent
+to the perimeter list and which lie outside the perimeter to our
+list.  (The loop is only slightly more complicated for armies and
+transports.)
+
+When our perimeter list becomes empty, or when the distance to
+the current perimeter is at least as large as the weighted distance
+to the best objective, we return the location of the best objective
+found.
+
+A cell lies outside of the current perimeter if it does not carry the
+path map's current generation (see PMAP_VALID); such cells read as
+having an INFINITY cost.  The cost for cells that lie
+on or within the current perimeter doesn't matter, except that
+the information must be consistent with the needs of 'vmap_mark_path'.
+*/
+
+/*
+Bitboard searches.
+
+When every move costs one, the next perimeter is just the set of cells
+next to the current perimeter that have not been reached yet.  We keep
+these sets as bitboards, so a row of the perimeter grows with a few
+shifts and ORs.  What a search needs to know about each cell is kept
+in bit planes: the cells it crosses, the cells it reaches but cannot
+cross (cities it does not own), the crossable cells that are water,
+and its objectives.  Planes are kept from one search to the next and
+brought up to date from the change ring, so only cells that changed
+are looked at again.
+
+The scalar search reaches the cells of a perimeter in a particular
+order, and when two objectives on one perimeter are equally good, the
+first one reached wins.  Bitboards do not know that order, so when it
+matters we work it out (see 'order_objectives').  The scalar search
+is still used when path maps are traced.
 */
 
-static path_map_t pmap_init[MAP_SIZE];
-static bool init_done = false;
+/* Return the index of the lowest set bit of a non-zero word. */
 
-static void start_perimeter(path_map_t *pmap, perimeter_t *perim, loc_t loc,
-                            int terrain) {
-	/* zap the path map */
-	if (!init_done) {
-		int i;
+static int low_bit(uint64_t w) {
+#if defined(__GNUC__)
+	return __builtin_ctzll(w);
+#else
+	int b = 0;
 
-		init_done = true;
-		for (i = 0; i < MAP_SIZE; i++) {
-			pmap_init[i].cost =
-			    INFINITY; /* everything lies outside perim */
-			pmap_init[i].terrain = T_UNKNOWN;
+	while (!(w & 1)) {
+		w >>= 1;
+		b += 1;
+	}
+	return b;
+#endif
+}
+
+/* the word and bit holding a location in a bitboard */
+#define BIT_WORD(rows, loc) ((rows)[loc_row(loc)][loc_col(loc) / 64])
+#define BIT_MASK(loc) ((uint64_t)1 << (loc_col(loc) % 64))
+
+/* Fill in the planes for one cell. */
+
+static void plane_cell(bit_planes_t *bp, view_map_t *vmap, loc_t loc) {
+	int row = loc_row(loc);
+	int w = loc_col(loc) / 64;
+	uint64_t bit = BIT_MASK(loc);
+	int type;
+
+	bp->pass[row][w] &= ~bit;
+	bp->stop[row][w] &= ~bit;
+	bp->wet[row][w] &= ~bit;
+	bp->goal[row][w] &= ~bit;
+
+	if (!game.real_map[loc].on_board) {
+		return;
+	}
+	if (vmap[loc].contents == ' ') {
+		bp->pass[row][w] |= bit; /* takes the terrain we came from */
+	} else {
+		type = terrain_type(NULL, vmap, bp->move_info, loc, loc);
+		if (type & bp->expand) {
+			bp->pass[row][w] |= bit;
+			if (type == T_WATER) {
+				bp->wet[row][w] |= bit;
+			}
+		} else if (type == T_UNKNOWN) {
+			bp->stop[row][w] |= bit;
 		}
 	}
-	(void)memcpy((char *)pmap, (char *)pmap_init, sizeof(pmap_init));
+	if (bp->move_info->weight_of[(uchar)vmap[loc].contents] != W_NONE) {
+		bp->goal[row][w] |= bit;
+	}
+}
 
-	/* put first location in perimeter */
-	pmap[loc].cost = 0;
-	pmap[loc].inc_cost = 0;
-	pmap[loc].terrain = terrain;
+/* Make sure a row of the planes is filled in. */
 
-	perim->len = 1;
-	perim->list[0] = loc;
+static void plane_row(bit_planes_t *bp, view_map_t *vmap, int row) {
+	int col;
 
-	best_cost = INFINITY; /* no best yet */
-	best_loc = loc;       /* if nothing found, result is current loc */
+	if (bp->made[row]) {
+		return;
+	}
+	for (col = 0; col < MAP_WIDTH; col++) {
+		plane_cell(bp, vmap, row_col_loc(row, col));
+	}
+	bp->made[row] = true;
 }
 
 /*
-Expand the perimeter.
+Find the planes for a search.  Only the player view maps note their
+changes; planes for any other map are made afresh for each search.
+*/
 
-Note that 'waterp' and 'landp' may be the same.
+static bit_planes_t *get_planes(path_ctx_t *ctx, view_map_t *vmap,
+                                move_info_t *move_info, int expand) {
+	bit_planes_t *bp, *oldest;
+	bool kept;
+	unsigned long n;
+	int i;
+
+	kept = vmap == game.comp_map || vmap == game.user_map;
+	ctx->plane_clock += 1;
+	oldest = &ctx->planes[0];
+
+	for (i = 0; i < NUM_PLANES; i++) {
+		bp = &ctx->planes[i];
+		if (kept && bp->vmap == vmap && bp->move_info == move_info &&
+		    bp->expand == expand) {
+			break;
+		}
+		if (bp->last_use < oldest->last_use) {
+			oldest = bp;
+		}
+	}
+	if (i == NUM_PLANES) { /* not found; start over in oldest */
+		bp = oldest;
+		bp->vmap = vmap;
+		bp->move_info = move_info;
+		bp->expand = expand;
+		bp->synced = change_clock + CHANGE_RING + 1;
+	}
+	if (!kept || change_clock - bp->synced > CHANGE_RING) {
+		for (i = 0; i < MAP_HEIGHT; i++) {
+			bp->made[i] = false;
+		}
+	} else {
+		for (n = bp->synced; n != change_clock; n++) {
+			loc_t loc = change_ring[n % CHANGE_RING];
+
+			if (bp->made[loc_row(loc)]) {
+				plane_cell(bp, vmap, loc);
+			}
+		}
+	}
+	bp->synced = change_clock;
+	bp->last_use = kept ? ctx->plane_clock : 0;
+	return bp;
+}
+
+/* Set 'to' to a row together with its neighbors to either side. */
+
+static void spread_row(uint64_t *from, uint64_t *to) {
+	int w;
+
+	for (w = 0; w < MAP_WORDS; w++) {
+		uint64_t east = from[w] << 1;
+		uint64_t west = from[w] >> 1;
+
+		if (w > 0) {
+			east |= from[w - 1] >> 63;
+		}
+		if (w < MAP_WORDS - 1) {
+			west |= from[w + 1] << 63;
+		}
+		to[w] = from[w] | east | west;
+	}
+}
+
+/*
+The cheapest objectives on the perimeter 'level' steps out are tied,
+or more than one of them marks its cell, so we need the order in which
+the scalar search would reach them.  We rebuild the order in which it
+lists the cells of each perimeter from the costs already in the path
+map, then run through the objectives marked in 'ctx->cand' in that
+order, as 'expand_perimeter' would.
+*/
+
+static void order_objectives(path_ctx_t *ctx, path_map_t *pmap,
+                             view_map_t *vmap, move_info_t *move_info,
+                             loc_t loc, int level) {
+	perimeter_t *from = &ctx->perim[0];
+	perimeter_t *to = &ctx->perim[1];
+	loc_t new_loc;
+	int obj_cost;
+	int d, j;
+	long i;
+
+	(void)memset(ctx->listed, 0, MAP_HEIGHT * sizeof(bit_row_t));
+	from->len = 1;
+	from->list[0] = loc;
+
+	for (d = 1; d <= level; d++) {
+		to->len = 0;
+		for (i = 0; i < from->len; i++) {
+			FOR_ADJ_ON(from->list[i], new_loc, j) {
+				if (PMAP_VALID(pmap, new_loc) &&
+				    pmap[new_loc].inc_cost == 1 &&
+				    pmap[new_loc].cost == d &&
+				    !(BIT_WORD(ctx->listed, new_loc) &
+				      BIT_MASK(new_loc))) {
+					BIT_WORD(ctx->listed, new_loc) |=
+					    BIT_MASK(new_loc);
+					to->list[to->len++] = new_loc;
+				}
+			}
+		}
+		SWAP(from, to);
+	}
+	for (i = 0; i < from->len; i++) {
+		FOR_ADJ_ON(from->list[i], new_loc, j) {
+			if (!(BIT_WORD(ctx->cand, new_loc) &
+			      BIT_MASK(new_loc))) {
+				continue;
+			}
+			BIT_WORD(ctx->cand, new_loc) &= ~BIT_MASK(new_loc);
+			obj_cost =
+			    objective_cost(vmap, move_info, new_loc, level);
+			if (obj_cost < ctx->best_cost) {
+				ctx->best_cost = obj_cost;
+				ctx->best_loc = new_loc;
+				if (pmap[new_loc].terrain == T_UNKNOWN) {
+					pmap[new_loc].cost = level + 2;
+					pmap[new_loc].inc_cost = 2;
+				}
+			}
+		}
+	}
+}
+
+/*
+Run 'vmap_find_xobj' on bitboards.  Which cells lie on each perimeter
+does not depend on the order they are reached in, so the path map
+comes out the same as the scalar search leaves it, except that
+unexplored cells crossed by a piece that goes over land and water are
+always called land.  That makes no difference to costs or paths.
+*/
+
+static loc_t bit_find_xobj(path_ctx_t *ctx, path_map_t *pmap,
+                           view_map_t *vmap, loc_t loc,
+                           move_info_t *move_info, int start, int expand,
+                           int max_cost) {
+	bit_planes_t *bp;
+	bit_row_t *front, *next, *x;
+	int lo, hi; /* rows holding the perimeter */
+	int cur_cost;
+	int r, w;
+
+	bp = get_planes(ctx, vmap, move_info, expand);
+	start_path_map(ctx, pmap, loc, start);
+
+	front = ctx->front;
+	next = ctx->next;
+	(void)memset(ctx->seen, 0, MAP_HEIGHT * sizeof(bit_row_t));
+	lo = hi = loc_row(loc);
+	for (w = 0; w < MAP_WORDS; w++) {
+		front[lo][w] = 0;
+	}
+	BIT_WORD(front, loc) = BIT_MASK(loc);
+	BIT_WORD(ctx->seen, loc) = BIT_MASK(loc);
+	cur_cost = 0;
+
+	for (;;) {
+		int first = lo > 0 ? lo - 1 : 0;
+		int last = hi < MAP_HEIGHT - 1 ? hi + 1 : MAP_HEIGHT - 1;
+		int new_lo = MAP_HEIGHT, new_hi = -1;
+		int beat = ctx->best_cost; /* objectives must beat this */
+		int low_cost = INFINITY;   /* cheapest objective found */
+		loc_t low_loc = 0;
+		int low_count = 0;  /* objectives that cheap */
+		int stop_count = 0; /* objectives in cells we cannot cross */
+		bool low_stop = false;
+
+		for (r = lo; r <= hi; r++) {
+			spread_row(front[r], ctx->spread[r]);
+		}
+		for (r = first; r <= last; r++) {
+			plane_row(bp, vmap, r);
+			for (w = 0; w < MAP_WORDS; w++) {
+				uint64_t pass = bp->pass[r][w];
+				uint64_t wet = bp->wet[r][w];
+				uint64_t goal = bp->goal[r][w];
+				uint64_t cells = 0;
+
+				if (r - 1 >= lo) {
+					cells |= ctx->spread[r - 1][w];
+				}
+				if (r >= lo && r <= hi) {
+					cells |= ctx->spread[r][w];
+				}
+				if (r + 1 <= hi) {
+					cells |= ctx->spread[r + 1][w];
+				}
+				cells &= ~ctx->seen[r][w] &
+				         (pass | bp->stop[r][w]);
+
+				ctx->seen[r][w] |= cells;
+				ctx->cand[r][w] = 0;
+				next[r][w] = cells & pass;
+				if (next[r][w]) {
+					if (r < new_lo) {
+						new_lo = r;
+					}
+					new_hi = r;
+				}
+				while (cells) {
+					int b = low_bit(cells);
+					uint64_t bit = (uint64_t)1 << b;
+					loc_t new_loc =
+					    row_col_loc(r, w * 64 + b);
+					path_map_t *pm = pmap + new_loc;
+					bool stop = !(pass & bit);
+					int obj_cost;
+
+					cells &= ~bit;
+					pm->gen = PMAP_GEN(pmap);
+					if (stop) {
+						pm->terrain = T_UNKNOWN;
+						pm->cost =
+						    cur_cost + INFINITY / 2;
+						pm->inc_cost = INFINITY / 2;
+					} else {
+						if (expand != T_AIR) {
+							pm->terrain = expand;
+						} else if (wet & bit) {
+							pm->terrain = T_WATER;
+						} else {
+							pm->terrain = T_LAND;
+						}
+						pm->cost = cur_cost + 1;
+						pm->inc_cost = 1;
+					}
+					if (!(goal & bit)) {
+						continue;
+					}
+					obj_cost =
+					    objective_cost(vmap, move_info,
+					                   new_loc, cur_cost);
+					if (obj_cost >= beat) {
+						continue;
+					}
+					ctx->cand[r][w] |= bit;
+					if (stop) {
+						stop_count += 1;
+					}
+					if (obj_cost < low_cost) {
+						low_cost = obj_cost;
+						low_loc = new_loc;
+						low_count = 1;
+						low_stop = stop;
+					} else if (obj_cost == low_cost) {
+						low_count += 1;
+					}
+				}
+			}
+		}
+		if (low_count > 1 || stop_count > (low_stop ? 1 : 0)) {
+			order_objectives(ctx, pmap, vmap, move_info, loc,
+			                 cur_cost);
+		} else if (low_count == 1) {
+			ctx->best_cost = low_cost;
+			ctx->best_loc = low_loc;
+			if (low_stop) {
+				pmap[low_loc].cost = cur_cost + 2;
+				pmap[low_loc].inc_cost = 2;
+			}
+		}
+		cur_cost += 1;
+		if (new_hi < 0 || ctx->best_cost <= cur_cost ||
+		    cur_cost >= max_cost) {
+			return ctx->best_loc;
+		}
+		x = front;
+		front = next;
+		next = x;
+		lo = new_lo;
+		hi = new_hi;
+	}
+}
+
+/*
+Find an objective over a single type of terrain.  We give up on cells
+more than 'max_cost' moves away, so a piece low on fuel only searches
+as far as it can fly.
+*/
+
+loc_t vmap_find_xobj(path_ctx_t *ctx, path_map_t path_map[], view_map_t *vmap,
+                     loc_t loc, move_info_t *move_info, int start, int expand,
+                     int max_cost) {
+	perimeter_t *from;
+	perimeter_t *to;
+	int cur_cost;
+
+	if (!game.trace_pmap) {
+		return bit_find_xobj(ctx, path_map, vmap, loc, move_info, start,
+		                     expand, max_cost);
+	}
+	from = &ctx->perim[0];
+	to = &ctx->perim[1];
+
+	start_perimeter(ctx, path_map, from, loc, start);
+	cur_cost = 0; /* cost to reach current perimeter */
+
+	for (;;) {
+		to->len = 0; /* nothing in perim yet */
+		expand_perimeter(ctx, path_map, vmap, move_info, from, expand,
+		                 cur_cost, 1, 1, to, to);
+
+		if (game.trace_pmap) {
+			print_pzoom("After xobj loop:", path_map, vmap);
+		}
+
+		cur_cost += 1;
+		if (to->len == 0 || ctx->best_cost <= cur_cost ||
+		    cur_cost >= max_cost) {
+			return ctx->best_loc;
+		}
+
+		SWAP(from, to);
+	}
+}
+
+/* Find an objective for a piece that crosses land and water. */
+
+loc_t vmap_find_aobj(path_ctx_t *ctx, path_map_t path_map[], view_map_t *vmap,
+                     loc_t loc, move_info_t *move_info, int max_cost) {
+	return vmap_find_xobj(ctx, path_map, vmap, loc, move_info, T_LAND,
+	                      T_AIR, max_cost);
+}
+
+/* Find an objective for a piece that crosses only water. */
+
+loc_t vmap_find_wobj(path_ctx_t *ctx, path_map_t path_map[], view_map_t *vmap,
+                     loc_t loc, move_info_t *move_info, int max_cost) {
+	return vmap_find_xobj(ctx, path_map, vmap, loc, move_info, T_WATER,
+	                      T_WATER, max_cost);
+}
+
+/* Find an objective for a piece that crosses only land. */
+
+loc_t vmap_find_lobj(path_ctx_t *ctx, path_map_t path_map[], view_map_t *vmap,
+                     loc_t loc, move_info_t *move_info, int max_cost) {
+	return vmap_find_xobj(ctx, path_map, vmap, loc, move_info, T_LAND,
+	                      T_LAND, max_cost);
+}
+
+/*
+Searches for pieces that cross both land and water.
+
+An army moves one cell a turn and a transport moves two, so we count
+cost in half turns: it costs 2 to move on land and 1 to move on water.
+A piece can only get on or off a transport at the start of a turn, so
+we only allow a step between land and water from a cell whose cost is
+a multiple of 'turn'.  The rules say which terrain may be entered from
+each kind of cell.
+*/
+
+typedef struct {
+	int land_cost;  /* cost to step onto land */
+	int water_cost; /* cost to step onto water */
+	int from_land;  /* terrain we may step onto from land */
+	int from_water; /* terrain we may step onto from water */
+	int turn;       /* terrain changes only at multiples of this cost */
+} step_rules_t;
+
+/* army walking to a transport */
+static step_rules_t lw_rules = {2, 1, T_AIR, T_WATER, 2};
+
+/* army riding a transport to land */
+static step_rules_t wl_rules = {2, 1, T_LAND, T_AIR, 2};
+
+/*
+Cells waiting to be expanded are kept in a bucket queue: a ring of
+buckets, one for each cost we can reach in a single step, each holding
+a list of water cells and a list of land cells.  Water cells are
+expanded before land cells of the same cost.  A cell is queued only
+the first time we reach it, so one link per cell is enough.
+*/
+
+#define B_WATER 0
+#define B_LAND 1
+
+/* Add a cell to the bucket for its cost. */
+
+static void bucket_add(path_ctx_t *ctx, path_map_t *pmap, loc_t loc) {
+	cell_list_t *list;
+
+	list = &ctx->buckets[pmap[loc].cost % NUM_BUCKETS]
+	               [pmap[loc].terrain == T_LAND ? B_LAND : B_WATER];
+	ctx->bucket_link[loc] = -1;
+	if (list->head == -1) {
+		list->head = loc;
+	} else {
+		ctx->bucket_link[list->tail] = loc;
+	}
+	list->tail = loc;
+	ctx->bucket_count += 1;
+}
+
+/*
+Expand one cell of a bucket search.  This is 'expand_perimeter' for a
+single cell, except that the step costs and the terrain we may enter
+come from the rules.
+*/
+
+static void expand_step(path_ctx_t *ctx, path_map_t *pmap, view_map_t *vmap,
+                        move_info_t *move_info, loc_t loc,
+                        step_rules_t *rules) {
+	path_map_t *pm;
+	loc_t new_loc;
+	int j;
+	int cur_cost;
+	int type;
+	int new_type;
+	int obj_cost;
+
+	cur_cost = pmap[loc].cost;
+	if (pmap[loc].terrain == T_LAND) {
+		type = rules->from_land;
+	} else {
+		type = rules->from_water;
+	}
+	if (cur_cost % rules->turn != 0) { /* can't change terrain now */
+		type &= pmap[loc].terrain;
+	}
+
+	FOR_ADJ_ON(loc, new_loc, j) {
+		pm = pmap + new_loc;
+		if (PMAP_COST(pmap, new_loc) != INFINITY) {
+			continue;
+		}
+		new_type = terrain_type(pmap, vmap, move_info, loc, new_loc);
+
+		if (new_type == T_LAND && (type & T_LAND)) {
+			pm->gen = PMAP_GEN(pmap);
+			pm->terrain = new_type;
+			pm->inc_cost = rules->land_cost;
+			pm->cost = cur_cost + rules->land_cost;
+			bucket_add(ctx, pmap, new_loc);
+		} else if (new_type == T_WATER && (type & T_WATER)) {
+			pm->gen = PMAP_GEN(pmap);
+			pm->terrain = new_type;
+			pm->inc_cost = rules->water_cost;
+			pm->cost = cur_cost + rules->water_cost;
+			bucket_add(ctx, pmap, new_loc);
+		} else if (new_type == T_UNKNOWN) { /* unreachable cell? */
+			pm->gen = PMAP_GEN(pmap);
+			pm->terrain = new_type;
+			pm->cost = cur_cost + INFINITY / 2;
+			pm->inc_cost = INFINITY / 2;
+		}
+		if (PMAP_COST(pmap, new_loc) != INFINITY) { /* did we expand? */
+			obj_cost =
+			    objective_cost(vmap, move_info, new_loc, cur_cost);
+			if (obj_cost < ctx->best_cost) {
+				ctx->best_cost = obj_cost;
+				ctx->best_loc = new_loc;
+				if (new_type == T_UNKNOWN) {
+					pm->cost = cur_cost + 2;
+					pm->inc_cost = 2;
+				}
+			}
+		}
+	}
+}
+
+/*
+Find an objective using a bucket queue.  We expand cells in order of
+cost until nothing is left or nothing left can beat the best objective
+found.  Since an objective costs at least as much as the cell we reach
+it from, we can stop as soon as the best cost is no more than the cost
+of the bucket we are about to expand.
+*/
+
+static loc_t vmap_find_bobj(path_ctx_t *ctx, path_map_t path_map[],
+                            view_map_t *vmap, loc_t loc, move_info_t *move_info,
+                            int start, step_rules_t *rules, int beat_cost) {
+	cell_list_t *list;
+	int cur_cost;
+	int b, t;
+	loc_t cell;
+
+	for (b = 0; b < NUM_BUCKETS; b++) {
+		ctx->buckets[b][B_WATER].head = -1;
+		ctx->buckets[b][B_LAND].head = -1;
+	}
+	ctx->bucket_count = 0;
+
+	start_path_map(ctx, path_map, loc, start);
+	bucket_add(ctx, path_map, loc);
+	ctx->best_cost = beat_cost; /* we can do this well */
+
+	for (cur_cost = 0; ctx->bucket_count != 0 && ctx->best_cost > cur_cost;
+	     cur_cost++) {
+		for (t = B_WATER; t <= B_LAND; t++) {
+			list = &ctx->buckets[cur_cost % NUM_BUCKETS][t];
+			for (cell = list->head; cell != -1;
+			     cell = ctx->bucket_link[cell]) {
+				expand_step(ctx, path_map, vmap, move_info,
+				            cell, rules);
+				ctx->bucket_count -= 1;
+			}
+			list->head = -1;
+		}
+		if (game.trace_pmap) {
+			print_pzoom("After bucket:", path_map, vmap);
+		}
+	}
+	return ctx->best_loc;
+}
+
+/*
+Find an objective moving from land to water.  It costs 2 to move
+on land and one to move on water, and once in the water we stay
+there.
+
+We have different objectives depending on whether the objective
+is being approached from the land or the water.
+*/
+
+loc_t vmap_find_lwobj(path_ctx_t *ctx, path_map_t path_map[], view_map_t *vmap,
+                      loc_t loc, move_info_t *move_info, int beat_cost) {
+	return vmap_find_bobj(ctx, path_map, vmap, loc, move_info, T_LAND,
+	                      &lw_rules, beat_cost);
+}
+
+#ifdef __UNUSED__
+/*
+Return the cost to reach the adjacent cell of the correct type
+with the lowest cost.
+*/
+
+static int best_adj(path_map_t *pmap, loc_t loc, int type) {
+	int i;
+	loc_t new_loc;
+	int best;
+
+	best = INFINITY;
+
+	FOR_ADJ(loc, new_loc, i)
+	if (PMAP_TERRAIN(pmap, new_loc) == type &&
+	    PMAP_COST(pmap, new_loc) < best) {
+		best = pmap[new_loc].cost;
+	}
+
+	return best;
+}
+#endif
+
+/*
+Find an objective moving from water to land.
+Here, we expand water to either land or water.
+We expand land only to land.
+
+We cheat ever so slightly, but this cheating accurately reflects
+the mechanics o moving.  Water reached at the start of a turn can
+be left for land (army moving off tt) or water (tt moving on water),
+but water reached mid-turn only leads to more water (tt taking its
+second move).
+*/
+
+loc_t vmap_find_wlobj(path_ctx_t *ctx, path_map_t path_map[], view_map_t *vmap,
+                      loc_t loc, move_info_t *move_info) {
+	return vmap_find_bobj(ctx, path_map, vmap, loc, move_info, T_WATER,
+	                      &wl_rules, INFINITY);
+}
+
+/*
+Initialize the perimeter searching.
+
+This routine was taking a significant amount of the program time (10%)
+doing the initialization of the path map.  It used to copy a constant
+map over the whole board; now we simply start a new generation, and
+only the cells a search actually reaches are ever written.
+*/
+
+static void start_path_map(path_ctx_t *ctx, path_map_t *pmap, loc_t loc,
+                           int terrain) {
+	ASSERT(!game.real_map[0].on_board);
+
+	/* zap the path map: everything lies outside perim */
+	if (++PMAP_GEN(pmap) == 0) { /* generation wrapped? */
+		int i;
+
+		for (i = 0; i < MAP_SIZE; i++) {
+			pmap[i].gen = 0;
+		}
+		PMAP_GEN(pmap) = 1;
+	}
+	pmap[0].cost = INFINITY; /* the header cell is never reached */
+	pmap[0].inc_cost = 0;
+	pmap[0].terrain = T_UNKNOWN;
+
+	/* put first location in perimeter */
+	claim_cell(pmap, loc);
+	pmap[loc].cost = 0;
+	pmap[loc].inc_cost = 0;
+	pmap[loc].terrain = terrain;
+
+	ctx->best_cost = INFINITY; /* no best yet */
+	ctx->best_loc = loc;       /* if nothing found, result is current loc */
+}
+
+static void start_perimeter(path_ctx_t *ctx, path_map_t *pmap,
+                            perimeter_t *perim, loc_t loc, int terrain) {
+	start_path_map(ctx, pmap, loc, terrain);
+
+	perim->len = 1;
+	perim->list[0] = loc;
+}
+
+/*
+Expand the perimeter.
+
+Note that 'waterp' and 'landp' may be the same.
 
 For each cell of the current perimeter, we examine each
 cell adjacent to that cell which lies outside of the current
@@ -530,9 +1487,10 @@ We set the cost to reach the current perimeter.
 */
 
 static void
-expand_perimeter(path_map_t *pmap, view_map_t *vmap, move_info_t *move_info,
-                 perimeter_t *curp, int type, int cur_cost, int inc_wcost,
-                 int inc_lcost, perimeter_t *waterp, perimeter_t *landp)
+expand_perimeter(path_ctx_t *ctx, path_map_t *pmap, view_map_t *vmap,
+                 move_info_t *move_info, perimeter_t *curp, int type,
+                 int cur_cost, int inc_wcost, int inc_lcost,
+                 perimeter_t *waterp, perimeter_t *landp)
 /* pmap = path map to up1date */
 /* move_info = objectives and weights */
 /* curp = perimeter to expand */
@@ -554,7 +1512,7 @@ expand_perimeter(path_map_t *pmap, view_map_t *vmap, move_info_t *move_info,
 		           j) { /* for each adjacent cell... */
 			register path_map_t *pm = pmap + new_loc;
 
-			if (pm->cost == INFINITY) {
+			if (PMAP_COST(pmap, new_loc) == INFINITY) {
 				new_type = terrain_type(pmap, vmap, move_info,
 				                        curp->list[i], new_loc);
 
@@ -567,17 +1525,18 @@ expand_perimeter(path_map_t *pmap, view_map_t *vmap, move_info_t *move_info,
 					         new_type, cur_cost, inc_wcost);
 				} else if (new_type ==
 				           T_UNKNOWN) { /* unreachable cell? */
+					pm->gen = PMAP_GEN(pmap);
 					pm->terrain = new_type;
 					pm->cost = cur_cost + INFINITY / 2;
 					pm->inc_cost = INFINITY / 2;
 				}
-				if (pmap[new_loc].cost !=
+				if (PMAP_COST(pmap, new_loc) !=
 				    INFINITY) { /* did we expand? */
 					obj_cost = objective_cost(
 					    vmap, move_info, new_loc, cur_cost);
-					if (obj_cost < best_cost) {
-						best_cost = obj_cost;
-						best_loc = new_loc;
+					if (obj_cost < ctx->best_cost) {
+						ctx->best_cost = obj_cost;
+						ctx->best_loc = new_loc;
 						if (new_type == T_UNKNOWN) {
 							pm->cost = cur_cost + 2;
 							pm->inc_cost = 2;
@@ -597,6 +1556,8 @@ static void add_cell(path_map_t *pmap, loc_t new_loc, perimeter_t *perim,
 
 	ASSERT(pm != NULL);
 
+	// cppcheck-suppress nullPointerRedundantCheck
+	pm->gen = PMAP_GEN(pmap);
 	// cppcheck-suppress nullPointerRedundantCheck
 	pm->terrain = terrain;
 	// cppcheck-suppress nullPointerRedundantCheck
@@ -612,20 +1573,31 @@ static void add_cell(path_map_t *pmap, loc_t new_loc, perimeter_t *perim,
 	perim->len += 1;
 }
 
+/*
+Bring a cell into the current generation without placing it on a
+perimeter.  A cell that was outside the perimeter stays there.
+*/
+
+static void claim_cell(path_map_t *pmap, loc_t loc) {
+	if (!PMAP_VALID(pmap, loc)) {
+		pmap[loc].gen = PMAP_GEN(pmap);
+		pmap[loc].cost = INFINITY;
+		pmap[loc].inc_cost = 0;
+		pmap[loc].terrain = T_UNKNOWN;
+	}
+}
+
 /* Compute the cost to move to an objective. */
 
 static int objective_cost(view_map_t *vmap, move_info_t *move_info, loc_t loc,
                           int base_cost) {
-	char *p;
 	int w;
 	city_info_t *cityp;
 
-	p = strchr(move_info->objectives, vmap[loc].contents);
-	if (!p) {
+	w = move_info->weight_of[(uchar)vmap[loc].contents];
+	if (w == W_NONE) {
 		return INFINITY;
 	}
-
-	w = move_info->weights[p - move_info->objectives];
 	if (w >= 0) {
 		return w + base_cost;
 	}
@@ -655,25 +1627,45 @@ static int objective_cost(view_map_t *vmap, move_info_t *move_info, loc_t loc,
 	}
 }
 
+/*
+Compile the objectives of a move_info into tables indexed by cell
+contents, so that the searches can size up a cell with one lookup.
+The first of repeated objectives counts, as it would for 'strchr'.
+*/
+
+void compile_move_info(move_info_t *move_info) {
+	int c, i;
+
+	for (c = 0; c < 256; c++) {
+		move_info->weight_of[c] = W_NONE;
+		move_info->terrain[c] = T_REAL;
+	}
+	for (i = 0; move_info->objectives[i] != '\0'; i++) {
+		c = (uchar)move_info->objectives[i];
+		if (move_info->weight_of[c] == W_NONE) {
+			move_info->weight_of[c] = move_info->weights[i];
+		}
+	}
+	move_info->terrain[(uchar)MAP_LAND] = T_LAND;
+	move_info->terrain[(uchar)MAP_SEA] = T_WATER;
+	move_info->terrain['%'] = T_UNKNOWN; /* magic objective */
+	move_info->terrain[' '] = T_FROM;    /* unexplored */
+}
+
 /*
 Return the type of terrain at a vmap location.
 */
 
 static int terrain_type(path_map_t *pmap, view_map_t *vmap,
                         move_info_t *move_info, loc_t from_loc, loc_t to_loc) {
-	if (vmap[to_loc].contents == MAP_LAND) {
-		return T_LAND;
-	}
-	if (vmap[to_loc].contents == MAP_SEA) {
-		return T_WATER;
+	int type = move_info->terrain[(uchar)vmap[to_loc].contents];
+
+	if (type == T_FROM) {
+		return pmap[from_loc].terrain;
 	}
-	if (vmap[to_loc].contents == '%') {
-		return T_UNKNOWN; /* magic objective */
+	if (type != T_REAL) {
+		return type;
 	}
-	if (vmap[to_loc].contents == ' ') {
-		return pmap[from_loc].terrain;
-	}
-
 	switch (game.real_map[to_loc].contents) {
 	case MAP_SEA:
 		return T_WATER;
@@ -716,33 +1708,39 @@ Then we make multiple passes extending our predictions.
 
 We stop if at any point all remaining unexplored cells are
 in a perimeter list, or if no predictions were made during
-one of the final passes.
+one of the final passes.  We return the number of cells still
+unexplored.
 
 Unlike other algorithms, here we deal with "off board" locations.
 So be careful.
 */
 
-void vmap_prune_explore_locs(view_map_t *vmap) {
-	path_map_t pmap[MAP_SIZE];
-	perimeter_t *from, *to;
-	int explored;
+static path_map_t *prune_pmap; /* see 'vmap_prune_explore_locs' */
+
+static long prune_passes(view_map_t *, path_map_t *, perimeter_t *,
+                         perimeter_t *, long, long);
+
+long vmap_prune_explore_locs(path_ctx_t *ctx, view_map_t *vmap) {
+	path_map_t *pmap = prune_pmap;
+	perimeter_t *from;
+	long left;
 	loc_t loc, new_loc;
 	count_t i;
-	long copied;
 
-	(void)memset(pmap, '\0', sizeof(pmap));
-	from = &p1;
-	to = &p2;
+	(void)memset(pmap, '\0', MAP_SIZE * sizeof(path_map_t));
+	from = &ctx->perim[0];
 	from->len = 0;
-	explored = 0;
+	left = MAP_CELLS;
 
 	/* build initial path map and perimeter list */
 	for (loc = 0; loc < MAP_SIZE; loc++) {
-		if (vmap[loc].contents != ' ') {
-			explored += 1;
+		if (!loc_on_map(loc)) {
+			; /* ignore padding */
+		} else if (vmap[loc].contents != ' ') {
+			left -= 1;
 		} else { /* add unexplored cell to perim */
 			FOR_ADJ(loc, new_loc, i) {
-				if (new_loc < 0 || new_loc >= MAP_SIZE) {
+				if (!loc_on_map(new_loc)) {
 					; /* ignore off map */
 				} else if (vmap[new_loc].contents == ' ') {
 					; /* ignore adjacent unexplored */
@@ -760,14 +1758,158 @@ void vmap_prune_explore_locs(view_map_t *vmap) {
 			}
 		}
 	}
+	return prune_passes(vmap, pmap, from, &ctx->perim[1], left, 0);
+}
+
+/*
+Predict again around cells of a pruned map that have been explored
+since it was pruned, which are listed in 'cells'.  The predictions
+within PRUNE_REACH of those cells are made afresh by the passes
+'vmap_prune_explore_locs' makes, counting the cells around them,
+explored or predicted, as the full passes would have.  Predictions
+farther away are kept, so the result is close to, but not always the
+same as, pruning the whole map again.
+
+'guess' tells which cells of the map are predictions, and 'blank' is
+the number of unexplored cells on the map, which we return brought up
+to date.  Cells whose contents change are noted (see 'vmap_changed').
+The cell lists of the context other than 'cells' are used.
+*/
+
+#define PRUNE_REACH 3
+
+static int loc_cmp(const void *a, const void *b) {
+	long x = *(const long *)a;
+	long y = *(const long *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Give the rows and columns of the cells near a cell. */
+
+static void prune_window(loc_t loc, int *row0, int *row1, int *col0,
+                         int *col1) {
+	*row0 = loc_row(loc) - PRUNE_REACH;
+	*row1 = loc_row(loc) + PRUNE_REACH;
+	*col0 = loc_col(loc) - PRUNE_REACH;
+	*col1 = loc_col(loc) + PRUNE_REACH;
+	if (*row0 < 0) {
+		*row0 = 0;
+	}
+	if (*row1 >= MAP_HEIGHT) {
+		*row1 = MAP_HEIGHT - 1;
+	}
+	if (*col0 < 0) {
+		*col0 = 0;
+	}
+	if (*col1 >= MAP_WIDTH) {
+		*col1 = MAP_WIDTH - 1;
+	}
+}
+
+long vmap_prune_explore_near(path_ctx_t *ctx, view_map_t *vmap, bool *guess,
+                             perimeter_t *cells, long blank) {
+	path_map_t *pmap = prune_pmap;
+	perimeter_t *from;
+	long taken, left, c;
+	int row0, row1, col0, col1, r, k;
+	loc_t loc, new_loc;
+	count_t i;
+
+	ASSERT(cells != &ctx->perim[0] && cells != &ctx->perim[1]);
+	PMAP_GEN(pmap) += 1; /* cells in play carry this generation */
+	from = &ctx->perim[0];
+	from->len = 0;
+
+	/* take back the predictions near the new cells */
+	for (c = 0; c < cells->len; c++) {
+		prune_window(cells->list[c], &row0, &row1, &col0, &col1);
+		for (r = row0; r <= row1; r++) {
+			for (k = col0; k <= col1; k++) {
+				loc = row_col_loc(r, k);
+				if (!guess[loc] || PMAP_VALID(pmap, loc)) {
+					continue;
+				}
+				pmap[loc].gen = PMAP_GEN(pmap);
+				pmap[loc].terrain = vmap[loc].contents;
+				if (vmap[loc].contents != ' ') {
+					vmap[loc].contents = ' ';
+					blank += 1;
+				}
+				from->list[from->len++] = loc;
+			}
+		}
+	}
+	taken = from->len;
+	qsort(from->list, from->len, sizeof(from->list[0]), loc_cmp);
+
+	/* count what lies around them */
+	k = 0;
+	for (c = 0; c < from->len; c++) {
+		loc = from->list[c];
+		pmap[loc].cost = 0;
+		pmap[loc].inc_cost = 0;
+		FOR_ADJ_ON(loc, new_loc, i) {
+			if (vmap[new_loc].contents == ' ') {
+				; /* ignore unexplored */
+			} else if (guess[new_loc]
+			               ? vmap[new_loc].contents == MAP_LAND
+			               : game.real_map[new_loc].contents !=
+			                     MAP_SEA) {
+				pmap[loc].cost += 1; /* count land */
+			} else {
+				pmap[loc].inc_cost += 1; /* count water */
+			}
+		}
+		if (pmap[loc].cost || pmap[loc].inc_cost) {
+			from->list[k++] = loc;
+		}
+	}
+	from->len = k;
+
+	left = prune_passes(vmap, pmap, from, &ctx->perim[1], taken,
+	                    blank - taken);
+
+	/* note the cells that came out differently */
+	for (c = 0; c < cells->len; c++) {
+		prune_window(cells->list[c], &row0, &row1, &col0, &col1);
+		for (r = row0; r <= row1; r++) {
+			for (k = col0; k <= col1; k++) {
+				loc = row_col_loc(r, k);
+				if (!PMAP_VALID(pmap, loc)) {
+					continue;
+				}
+				pmap[loc].gen = 0; /* out of play */
+				if (vmap[loc].contents != pmap[loc].terrain) {
+					vmap_changed(loc);
+				}
+			}
+		}
+	}
+	return blank - (taken - left);
+}
+
+/*
+Make the prediction passes for 'vmap_prune_explore_locs' and
+'vmap_prune_explore_near', starting from the perimeter 'from'.  'left'
+cells in play are unexplored, and 'outside' more cells out of play.
+We return how many cells in play are still unexplored.
+*/
+
+static long prune_passes(view_map_t *vmap, path_map_t *pmap,
+                         perimeter_t *from, perimeter_t *to, long left,
+                         long outside) {
+	count_t i;
+	loc_t loc;
+	long copied;
 
 	if (game.print_vmap == 'I') {
 		print_xzoom(vmap);
 	}
 
 	for (;;) { /* do high probability predictions */
-		if (from->len + explored == MAP_SIZE) {
-			return;
+		if (from->len == left + outside) {
+			return left;
 		}
 		to->len = 0;
 		copied = 0;
@@ -776,28 +1918,32 @@ void vmap_prune_explore_locs(view_map_t *vmap) {
 			loc = from->list[i];
 			if (pmap[loc].cost >= 5) {
 				expand_prune(vmap, pmap, loc, T_LAND, to,
-				             &explored);
+				             &left);
 			} else if (pmap[loc].inc_cost >= 5) {
 				expand_prune(vmap, pmap, loc, T_WATER, to,
-				             &explored);
-			} else if ((loc < MAP_WIDTH ||
-			            loc >= MAP_SIZE - MAP_WIDTH) &&
+				             &left);
+			} else if ((loc_row(loc) == 0 ||
+			            loc_row(loc) == MAP_HEIGHT - 1) &&
 			           pmap[loc].cost >= 3) {
 				expand_prune(vmap, pmap, loc, T_LAND, to,
-				             &explored);
-			} else if ((loc < MAP_WIDTH ||
-			            loc >= MAP_SIZE - MAP_WIDTH) &&
+				             &left);
+			} else if ((loc_row(loc) == 0 ||
+			            loc_row(loc) == MAP_HEIGHT - 1) &&
 			           pmap[loc].inc_cost >= 3) {
 				expand_prune(vmap, pmap, loc, T_WATER, to,
-				             &explored);
-			} else if ((loc == 0 || loc == MAP_SIZE - 1) &&
+				             &left);
+			} else if ((loc == row_col_loc(0, 0) ||
+			            loc == row_col_loc(MAP_HEIGHT - 1,
+			                               MAP_WIDTH - 1)) &&
 			           pmap[loc].cost >= 2) {
 				expand_prune(vmap, pmap, loc, T_LAND, to,
-				             &explored);
-			} else if ((loc == 0 || loc == MAP_SIZE - 1) &&
+				             &left);
+			} else if ((loc == row_col_loc(0, 0) ||
+			            loc == row_col_loc(MAP_HEIGHT - 1,
+			                               MAP_WIDTH - 1)) &&
 			           pmap[loc].inc_cost >= 2) {
 				expand_prune(vmap, pmap, loc, T_WATER, to,
-				             &explored);
+				             &left);
 			} else { /* copy perimeter cell */
 				to->list[to->len] = loc;
 				to->len += 1;
@@ -815,17 +1961,17 @@ void vmap_prune_explore_locs(view_map_t *vmap) {
 	}
 
 	/* one pass for medium probability predictions */
-	if (from->len + explored == MAP_SIZE) {
-		return;
+	if (from->len == left + outside) {
+		return left;
 	}
 	to->len = 0;
 
 	for (i = 0; i < from->len; i++) {
 		loc = from->list[i];
 		if (pmap[loc].cost > pmap[loc].inc_cost) {
-			expand_prune(vmap, pmap, loc, T_LAND, to, &explored);
+			expand_prune(vmap, pmap, loc, T_LAND, to, &left);
 		} else if (pmap[loc].cost < pmap[loc].inc_cost) {
-			expand_prune(vmap, pmap, loc, T_WATER, to, &explored);
+			expand_prune(vmap, pmap, loc, T_WATER, to, &left);
 		} else { /* copy perimeter cell */
 			to->list[to->len] = loc;
 			to->len += 1;
@@ -840,11 +1986,11 @@ void vmap_prune_explore_locs(view_map_t *vmap) {
 	/* multiple low probability passes */
 	for (;;) {
 		/* return if very little left to explore */
-		if (from->len + explored >= MAP_SIZE - MAP_HEIGHT) {
+		if (left + outside - from->len <= MAP_HEIGHT) {
 			if (game.print_vmap == 'I') {
 				print_xzoom(vmap);
 			}
-			return;
+			return left;
 		}
 		to->len = 0;
 		copied = 0;
@@ -853,21 +1999,21 @@ void vmap_prune_explore_locs(view_map_t *vmap) {
 			loc = from->list[i];
 			if (pmap[loc].cost >= 4 && pmap[loc].inc_cost < 4) {
 				expand_prune(vmap, pmap, loc, T_LAND, to,
-				             &explored);
+				             &left);
 			} else if (pmap[loc].inc_cost >= 4 &&
 			           pmap[loc].cost < 4) {
 				expand_prune(vmap, pmap, loc, T_WATER, to,
-				             &explored);
-			} else if ((loc < MAP_WIDTH ||
-			            loc >= MAP_SIZE - MAP_WIDTH) &&
+				             &left);
+			} else if ((loc_row(loc) == 0 ||
+			            loc_row(loc) == MAP_HEIGHT - 1) &&
 			           pmap[loc].cost > pmap[loc].inc_cost) {
 				expand_prune(vmap, pmap, loc, T_LAND, to,
-				             &explored);
-			} else if ((loc < MAP_WIDTH ||
-			            loc >= MAP_SIZE - MAP_WIDTH) &&
+				             &left);
+			} else if ((loc_row(loc) == 0 ||
+			            loc_row(loc) == MAP_HEIGHT - 1) &&
 			           pmap[loc].inc_cost > pmap[loc].cost) {
 				expand_prune(vmap, pmap, loc, T_WATER, to,
-				             &explored);
+				             &left);
 			} else { /* copy perimeter cell */
 				to->list[to->len] = loc;
 				to->len += 1;
@@ -882,6 +2028,7 @@ void vmap_prune_explore_locs(view_map_t *vmap) {
 	if (game.print_vmap == 'I') {
 		print_xzoom(vmap);
 	}
+	return left;
 }
 
 /*
@@ -894,11 +2041,11 @@ Careful:  'loc' may be "off board".
 */
 
 static void expand_prune(view_map_t *vmap, path_map_t *pmap, loc_t loc,
-                         int type, perimeter_t *to, int *explored) {
+                         int type, perimeter_t *to, long *left) {
 	int i;
 	loc_t new_loc;
 
-	*explored += 1;
+	*left -= 1;
 
 	if (type == T_LAND) {
 		vmap[loc].contents = MAP_LAND;
@@ -907,8 +2054,8 @@ static void expand_prune(view_map_t *vmap, path_map_t *pmap, loc_t loc,
 	}
 
 	FOR_ADJ(loc, new_loc, i)
-	if (new_loc >= 0 && new_loc < MAP_SIZE &&
-	    vmap[new_loc].contents == ' ') {
+	if (loc_on_map(new_loc) && vmap[new_loc].contents == ' ' &&
+	    PMAP_VALID(pmap, new_loc)) {
 		if (!pmap[new_loc].cost && !pmap[new_loc].inc_cost) {
 			to->list[to->len] = new_loc;
 			to->len += 1;
@@ -922,245 +2069,1235 @@ static void expand_prune(view_map_t *vmap, path_map_t *pmap, loc_t loc,
 }
 
 /*
-Find the shortest path from the current location to the
-destination which passes over valid terrain.  We return
-the destination if a path exists.  Otherwise we return the
-origin.
-
-This is similar to 'find_objective' except that we know our destination.
+Find the shortest path from the current location to the
+destination which passes over valid terrain.  We return
+the destination if a path exists.  Otherwise we return the
+origin.
+
+When the destination is far away we route over clusters instead (see
+'route_waypoint'), and return the next point on that route.  The path
+map then holds the shortest paths to that point which stay in our
+cluster, so that each move brings us closer along the route; if no
+path stays in it we search the whole map.  A near destination is
+always searched for over the whole map.
+*/
+
+loc_t vmap_find_dest(path_ctx_t *ctx, path_map_t path_map[], view_map_t vmap[],
+                     loc_t cur_loc, loc_t dest_loc, int owner, int terrain)
+/* cur_loc = current location of piece */
+/* dest_loc = destination of piece */
+/* owner = owner of piece being moved */
+/* terrain = terrain we can cross */
+{
+	loc_t new_loc;
+
+	ctx->box = -1;
+	if (vmap_route_far(cur_loc, dest_loc, terrain)) {
+		new_loc = route_waypoint(ctx, vmap, cur_loc, dest_loc, owner,
+		                         terrain);
+		if (new_loc != dest_loc) {
+			ctx->box = loc_cluster(cur_loc);
+		}
+		dest_loc = new_loc;
+	}
+	if (ctx->box >= 0) {
+		new_loc = find_dest(ctx, path_map, vmap, cur_loc, dest_loc,
+		                    owner, terrain);
+		if (new_loc != cur_loc) {
+			return new_loc;
+		}
+	}
+	ctx->box = -1;
+	return find_dest(ctx, path_map, vmap, cur_loc, dest_loc, owner,
+	                 terrain);
+}
+
+/*
+Search for the destination for 'vmap_find_dest'.  This is similar to
+'find_objective' except that we know our destination, so rather than
+flooding outward we run an A* search.  Cells are kept
+in buckets by their estimated total cost, which is the cost to reach
+the cell plus its 'dist' to the destination.  A move changes each of
+those by at most one, so a newly reached cell always lands in the
+current bucket or one of the next two, and three perimeter lists
+are enough.
+
+We do not stop at the first route found.  Every cell whose estimate
+is no worse than the best cost is expanded, so every cell on a
+shortest path carries its exact cost and 'vmap_mark_path' marks the
+same cells the breadth first search did.
+*/
+
+static loc_t find_dest(path_ctx_t *ctx, path_map_t path_map[],
+                       view_map_t vmap[], loc_t cur_loc, loc_t dest_loc,
+                       int owner, int terrain) {
+	perimeter_t *bucket[3];
+	perimeter_t *x;
+	int cur_est; /* estimated total cost of cells in bucket[0] */
+	int start_terrain;
+	move_info_t *move_info;
+	char old_contents;
+	long i;
+
+	ASSERT(owner > UNOWNED && owner < MAX_PLAYERS);
+	old_contents = vmap[dest_loc].contents;
+	vmap[dest_loc].contents = '%'; /* mark objective */
+	move_info = &dest_info[owner];
+
+	bucket[0] = &ctx->perim[0];
+	bucket[1] = &ctx->perim[1];
+	bucket[2] = &ctx->perim[2];
+
+	if (terrain == T_AIR) {
+		start_terrain = T_LAND;
+	} else {
+		start_terrain = terrain;
+	}
+
+	start_perimeter(ctx, path_map, bucket[0], cur_loc, start_terrain);
+	bucket[1]->len = 0;
+	bucket[2]->len = 0;
+	cur_est = dist(cur_loc, dest_loc);
+
+	for (;;) {
+		/* the bucket may grow while we walk it */
+		for (i = 0; i < bucket[0]->len; i++) {
+			loc_t loc = bucket[0]->list[i];
+
+			if (path_map[loc].cost + dist(loc, dest_loc) !=
+			    cur_est) {
+				continue; /* reached more cheaply since */
+			}
+			expand_dest_cell(ctx, path_map, vmap, move_info, loc,
+			                 dest_loc, terrain, bucket, cur_est);
+		}
+		if (ctx->best_cost <= cur_est ||
+		    (bucket[1]->len == 0 && bucket[2]->len == 0)) {
+			vmap[dest_loc].contents = old_contents;
+			return ctx->best_loc;
+		}
+		x = bucket[0];
+		bucket[0] = bucket[1];
+		bucket[1] = bucket[2];
+		bucket[2] = x;
+		bucket[2]->len = 0;
+		cur_est += 1;
+	}
+}
+
+/*
+Expand one cell for 'vmap_find_dest'.  This is 'expand_perimeter'
+for a single cell with unit costs, except that a cell we have already
+reached is moved to a cheaper bucket if we found a shorter way to it.
+*/
+
+static void expand_dest_cell(path_ctx_t *ctx, path_map_t *pmap,
+                             view_map_t *vmap, move_info_t *move_info,
+                             loc_t loc, loc_t dest_loc, int type,
+                             perimeter_t **bucket, int cur_est)
+/* loc = cell to expand */
+/* type = type of terrain to expand */
+/* bucket = perimeters for estimates cur_est, cur_est+1, cur_est+2 */
+{
+	int j;
+	loc_t new_loc;
+	int cur_cost;
+	int obj_cost;
+	int new_type;
+
+	cur_cost = pmap[loc].cost;
+
+	FOR_ADJ_ON(loc, new_loc, j) {
+		path_map_t *pm = pmap + new_loc;
+
+		if (new_loc != dest_loc && !in_box(ctx, new_loc)) {
+			continue;
+		}
+		if (PMAP_COST(pmap, new_loc) == INFINITY) {
+			new_type = terrain_type(pmap, vmap, move_info, loc,
+			                        new_loc);
+
+			if ((new_type == T_LAND || new_type == T_WATER) &&
+			    (type & new_type)) {
+				add_cell(pmap, new_loc,
+				         bucket[cur_cost + 1 +
+				                dist(new_loc,
+				                     dest_loc) - cur_est],
+				         new_type, cur_cost, 1);
+			} else if (new_type ==
+			           T_UNKNOWN) { /* unreachable cell? */
+				pm->gen = PMAP_GEN(pmap);
+				pm->terrain = new_type;
+				pm->cost = cur_cost + INFINITY / 2;
+				pm->inc_cost = INFINITY / 2;
+			}
+			if (PMAP_COST(pmap, new_loc) !=
+			    INFINITY) { /* did we expand? */
+				obj_cost = objective_cost(vmap, move_info,
+				                          new_loc, cur_cost);
+				if (obj_cost < ctx->best_cost) {
+					ctx->best_cost = obj_cost;
+					ctx->best_loc = new_loc;
+					if (new_type == T_UNKNOWN) {
+						pm->cost = cur_cost + 2;
+						pm->inc_cost = 2;
+					}
+				}
+			}
+		} else if ((pm->terrain == T_LAND || pm->terrain == T_WATER) &&
+		           pm->cost > cur_cost + 1) { /* shorter way here? */
+			add_cell(pmap, new_loc,
+			         bucket[cur_cost + 1 + dist(new_loc, dest_loc) -
+			                cur_est],
+			         pm->terrain, cur_cost, 1);
+		}
+	}
+}
+
+/*
+Starting with the destination, we back track toward the source marking
+all cells which are on a shortest path between the start and the
+destination.  The destination is on a path.  We then find the cells
+adjacent to the destination and nearest to the source and place them
+on the path.
+
+If we know square P is on the path, then S is on the path if S is
+adjacent to P, the cost to reach S is less than the cost to reach P,
+and the cost to move from S to P is the difference in cost between
+S and P.  The search leaves that cost and difference in every cell,
+so they are all the predecessor links we need.
+
+Cells are marked as they are put on a work list, so each is looked
+at once however many paths run through it, and the walk uses no
+more stack on a long path than on a short one.
+*/
+
+void vmap_mark_path(path_ctx_t *ctx, path_map_t *path_map, view_map_t *vmap,
+                    loc_t dest) {
+	perimeter_t *work = &ctx->perim[0];
+	loc_t loc, new_loc;
+	int n;
+
+	if (PMAP_COST(path_map, dest) == 0) {
+		return; /* reached end of path */
+	}
+	if (PMAP_TERRAIN(path_map, dest) == T_PATH) {
+		return; /* already marked */
+	}
+	claim_cell(path_map, dest);
+	path_map[dest].terrain = T_PATH; /* this square is on path */
+	work->list[0] = dest;
+	work->len = 1;
+
+	while (work->len > 0) {
+		loc = work->list[--work->len];
+
+		/* mark adjacent squares on shortest path */
+		FOR_ADJ(loc, new_loc, n) {
+			if (PMAP_COST(path_map, new_loc) !=
+			        path_map[loc].cost - path_map[loc].inc_cost ||
+			    PMAP_COST(path_map, new_loc) == 0 ||
+			    PMAP_TERRAIN(path_map, new_loc) == T_PATH) {
+				continue;
+			}
+			claim_cell(path_map, new_loc);
+			path_map[new_loc].terrain = T_PATH;
+			work->list[work->len++] = new_loc;
+		}
+	}
+}
+
+/*
+Create a marked path map.  We mark those squares adjacent to the
+starting location which are on the board.  'find_dir' must be
+invoked to decide which squares are actually valid.
+*/
+
+void vmap_mark_adjacent(path_map_t path_map[], loc_t loc) {
+	int i;
+	loc_t new_loc;
+
+	FOR_ADJ_ON(loc, new_loc, i) {
+		claim_cell(path_map, new_loc);
+		path_map[new_loc].terrain = T_PATH;
+	}
+}
+
+/*
+Modify a marked path map.  We mark those squares adjacent to the
+starting location which are on the board and which are adjacent
+to a location on the existing shortest path.
+*/
+
+void vmap_mark_near_path(path_map_t path_map[], loc_t loc) {
+	int i, j;
+	loc_t new_loc, xloc;
+	int hit_loc[8];
+
+	(void)memset((char *)hit_loc, '\0', sizeof(int) * 8);
+
+	FOR_ADJ_ON(loc, new_loc, i) {
+		FOR_ADJ_ON(new_loc, xloc, j)
+		if (xloc != loc && PMAP_TERRAIN(path_map, xloc) == T_PATH) {
+			hit_loc[i] = 1;
+			break;
+		}
+	}
+	for (i = 0; i < 8; i++) {
+		if (hit_loc[i]) {
+			claim_cell(path_map, loc + dir_offset[i]);
+			path_map[loc + dir_offset[i]].terrain = T_PATH;
+		}
+	}
+}
+
+/*
+Look at each neighbor of 'loc'.  Select the first marked cell which
+is on a short path to the desired destination, and which holds a valid
+terrain.  Note that while this terrain is matched against a 'vmap',
+it differs slightly from terrains used above.  This terrain is the
+terrain to which we can move immediately, and does not include terrain
+for which we would have to wait for another piece to move off of.
+
+We prefer diagonal moves, and we try to have as many squares
+as possible containing something in 'adj_char'.
+
+For tie-breaking, we prefer moving to cells that are adjacent to
+as many other squares on the path.  This should have a few benefits:
+
+1)  Fighters are less likely to be blocked from reaching a city
+because they stay in the center of the path and increase the number
+of options for subsequent moves.
+
+2)  Transports will approach a city so that as many armies
+as possible can hop off the tt on one turn to take a valid
+path toward the city.
+
+3)  User pieces will move more intuitively by staying in the
+center of the best path.
+*/
+
+static int order[] = {NORTHWEST, NORTHEAST, SOUTHWEST, SOUTHEAST,
+                      WEST,      EAST,      NORTH,     SOUTH};
+
+loc_t vmap_find_dir(path_map_t path_map[], view_map_t *vmap, loc_t loc,
+                    char *terrain, char *adj_char) {
+	int i, count, bestcount;
+	loc_t bestloc;
+	int path_count, bestpath;
+	char *p;
+
+	if (game.trace_pmap) {
+		print_pzoom("Before vmap_find_dir:", path_map, vmap);
+	}
+
+	bestcount = -INFINITY; /* no best yet */
+	bestpath = -1;
+	bestloc = loc;
+
+	for (i = 0; i < 8; i++) { /* for each adjacent square */
+		loc_t new_loc = loc + dir_offset[order[i]];
+		if (PMAP_TERRAIN(path_map, new_loc) ==
+		    T_PATH) { /* which is on path */
+			p = strchr(terrain, vmap[new_loc].contents);
+
+			if (p != NULL) { /* desirable square? */
+				count = vmap_count_adjacent(vmap, new_loc,
+				                            adj_char);
+				path_count = vmap_count_path(path_map, new_loc);
+
+				/* remember best location */
+				if (count > bestcount ||
+				    (count == bestcount &&
+				     path_count > bestpath)) {
+					bestcount = count;
+					bestpath = path_count;
+					bestloc = new_loc;
+				}
+			}
+		}
+	}
+	return (bestloc);
+}
+
+/*
+Count the number of adjacent squares of interest.
+Squares are weighted so that the first in the list
+is the most interesting.
+*/
+
+int vmap_count_adjacent(view_map_t *vmap, loc_t loc, char *adj_char) {
+	int i, count;
+	loc_t new_loc;
+	char *p;
+	int len;
+
+	len = strlen(adj_char);
+
+	count = 0;
+
+	FOR_ADJ_ON(loc, new_loc, i) {
+		p = strchr(adj_char, vmap[new_loc].contents);
+		if (p) {
+			count += 8 * (len - (p - adj_char));
+		}
+	}
+	return (count);
+}
+
+/*
+   Count the number of adjacent cells that are on the path.
+ */
+
+int vmap_count_path(path_map_t *pmap, loc_t loc) {
+	int i, count;
+	loc_t new_loc;
+
+	count = 0;
+
+	FOR_ADJ_ON(loc, new_loc, i)
+	if (PMAP_TERRAIN(pmap, new_loc) == T_PATH) {
+		count += 1;
+	}
+
+	return (count);
+}
+
+/*
+Flow fields for pieces heading to a known destination.
+
+Pieces are often sent to the same place (a city can send every army
+it builds to one rally point), and each of them used to run
+'vmap_find_dest' and 'vmap_mark_path' on every step.  Instead we flood
+once backward from the destination, recording how many moves each
+cell is from it, and keep the result for the rest of the turn.  A piece
+then reads its next step straight from the field.
+
+Pieces on land or water only use a field once they are near the
+destination (see 'vmap_route_far'); farther away they follow a route
+over clusters.  Like 'vmap_find_dest', the field covers the whole map.
+
+A field only depends on which cells a piece can cross.  Fields are
+kept in the search context.  Before one is used we look over the cells
+changed since (see 'vmap_changed'), and throw it away if a cell it
+looked at has become crossable or stopped being crossable.  Fields
+are also thrown away when the turn ends.
+*/
+
+#define FLOW_UNSEEN 0  /* cell was not looked at */
+#define FLOW_BLOCKED 1 /* cell cannot be crossed */
+#define FLOW_OPEN 2    /* cell can be crossed */
+
+/*
+Return true if a piece can cross a cell.  This follows 'terrain_type'.
+Unexplored territory takes the terrain of the cell we arrive from,
+which we could cross, so it is always open.
+*/
+
+static bool flow_open(view_map_t *vmap, loc_t loc, int owner, int terrain) {
+	int type;
+
+	switch (vmap[loc].contents) {
+	case MAP_LAND:
+		type = T_LAND;
+		break;
+	case MAP_SEA:
+		type = T_WATER;
+		break;
+	case ' ':
+		return true;
+	default:
+		switch (game.real_map[loc].contents) {
+		case MAP_SEA:
+			type = T_WATER;
+			break;
+		case MAP_LAND:
+			type = T_LAND;
+			break;
+		default: /* city */
+			if (game.real_map[loc].cityp->owner == owner) {
+				type = T_WATER;
+			} else {
+				type = T_UNKNOWN; /* cannot cross */
+			}
+			break;
+		}
+		break;
+	}
+	return (type & terrain) != 0;
+}
+
+/*
+Throw away a context's fields that a change made since they were last
+looked at may have spoiled, or that were built on an earlier turn.
+*/
+
+static void flow_sync(path_ctx_t *ctx) {
+	flow_field_t *f;
+	unsigned long n;
+	loc_t loc;
+	int i;
+
+	for (i = 0; i < NUM_FLOWS; i++) {
+		f = &ctx->flows[i];
+		if (f->vmap == NULL) {
+			continue;
+		}
+		if (f->date != game.date ||
+		    change_clock - f->synced > CHANGE_RING) {
+			f->vmap = NULL;
+			continue;
+		}
+		for (n = f->synced; n != change_clock; n++) {
+			loc = change_ring[n % CHANGE_RING];
+			if (f->state[loc] != FLOW_UNSEEN &&
+			    (f->state[loc] == FLOW_OPEN) !=
+			        flow_open(f->vmap, loc, f->owner, f->terrain)) {
+				f->vmap = NULL;
+				break;
+			}
+		}
+		f->synced = change_clock;
+	}
+}
+
+/* Flood a flow field backward from its destination. */
+
+static void flow_build(path_ctx_t *ctx, flow_field_t *f) {
+	perimeter_t *from;
+	perimeter_t *to;
+	long i;
+	int j;
+	int cost;
+	loc_t new_loc;
+
+	for (i = 0; i < MAP_SIZE; i++) {
+		f->dist[i] = INFINITY;
+	}
+	(void)memset(f->state, FLOW_UNSEEN, MAP_SIZE);
+
+	if (!game.real_map[f->dest].on_board) {
+		return; /* can't get there */
+	}
+	f->dist[f->dest] = 0;
+
+	from = &ctx->perim[0];
+	to = &ctx->perim[1];
+	from->len = 1;
+	from->list[0] = f->dest;
+
+	for (cost = 1; from->len != 0; cost++) {
+		to->len = 0;
+		for (i = 0; i < from->len; i++) {
+			FOR_ADJ_ON(from->list[i], new_loc, j) {
+				if (new_loc == f->dest ||
+				    f->state[new_loc] != FLOW_UNSEEN) {
+					continue;
+				}
+				if (flow_open(f->vmap, new_loc, f->owner,
+				              f->terrain)) {
+					f->state[new_loc] = FLOW_OPEN;
+					f->dist[new_loc] = cost;
+					to->list[to->len++] = new_loc;
+				} else {
+					f->state[new_loc] = FLOW_BLOCKED;
+				}
+			}
+		}
+		SWAP(from, to);
+	}
+}
+
+/* Find the field for a destination, building it if need be. */
+
+static flow_field_t *flow_get(path_ctx_t *ctx, view_map_t *vmap, loc_t dest,
+                              int owner, int terrain) {
+	flow_field_t *f;
+	flow_field_t *victim;
+	int i;
+
+	flow_sync(ctx);
+	victim = NULL;
+	for (i = 0; i < NUM_FLOWS; i++) {
+		f = &ctx->flows[i];
+		if (f->vmap == vmap && f->dest == dest && f->owner == owner &&
+		    f->terrain == terrain) {
+			f->last_use = ++ctx->flow_clock;
+			return f;
+		}
+		if (victim == NULL ||
+		    (victim->vmap != NULL &&
+		     (f->vmap == NULL || f->last_use < victim->last_use))) {
+			victim = f;
+		}
+	}
+	f = victim;
+	if (f->dist == NULL) { /* first use since the context was sized */
+		RESIZE(f->dist, MAP_SIZE);
+		RESIZE(f->state, MAP_SIZE);
+	}
+	f->vmap = vmap;
+	f->dest = dest;
+	f->owner = owner;
+	f->terrain = terrain;
+	f->date = game.date;
+	f->synced = change_clock;
+	f->last_use = ++ctx->flow_clock;
+	flow_build(ctx, f);
+	return f;
+}
+
+/*
+Return true if a cell lies on a shortest path from 'loc' to the
+destination, where 'total' is the length of such a path.  This is only
+asked about cells within two moves of 'loc'.  A cell two moves away
+is only on the path if a crossable cell between it and 'loc' is too.
+*/
+
+static bool flow_on_path(flow_field_t *f, loc_t loc, int total, loc_t xloc) {
+	loc_t mid;
+	int i;
+
+	if (xloc == loc) {
+		return false; /* start is never on the path */
+	}
+	if (xloc == f->dest) {
+		return true;
+	}
+	if (f->dist[xloc] == INFINITY ||
+	    dist(loc, xloc) + f->dist[xloc] != total) {
+		return false;
+	}
+	if (dist(loc, xloc) == 1) {
+		return true;
+	}
+	FOR_ADJ_ON(xloc, mid, i)
+	if (dist(loc, mid) == 1 && f->dist[mid] == total - 1) {
+		return true;
+	}
+	return false;
+}
+
+/*
+Pick a move toward a destination using a flow field.  This gives the
+same move as 'vmap_find_dest' followed by 'vmap_mark_path' and
+'vmap_find_dir'.  We return the current location if the destination
+cannot be reached or no move toward it is possible.
+*/
+
+loc_t vmap_find_flow_dir(path_ctx_t *ctx, view_map_t vmap[], loc_t cur_loc,
+                         loc_t dest_loc, int owner, int terrain,
+                         char *move_terrain, char *adj_char) {
+	flow_field_t *f;
+	int i, j;
+	int total;
+	int count, bestcount;
+	int path_count, bestpath;
+	loc_t new_loc, xloc;
+	loc_t bestloc;
+
+	if (cur_loc == dest_loc) {
+		return cur_loc;
+	}
+	f = flow_get(ctx, vmap, dest_loc, owner, terrain);
+
+	total = INFINITY; /* length of shortest path */
+	FOR_ADJ_ON(cur_loc, new_loc, i)
+	if (f->dist[new_loc] + 1 < total) {
+		total = f->dist[new_loc] + 1;
+	}
+	if (total == INFINITY) {
+		return cur_loc; /* can't get there */
+	}
+
+	bestcount = -INFINITY; /* no best yet */
+	bestpath = -1;
+	bestloc = cur_loc;
+
+	for (i = 0; i < 8; i++) { /* for each adjacent square */
+		new_loc = cur_loc + dir_offset[order[i]];
+		if (!flow_on_path(f, cur_loc, total, new_loc) ||
+		    strchr(move_terrain, vmap[new_loc].contents) == NULL) {
+			continue;
+		}
+		count = vmap_count_adjacent(vmap, new_loc, adj_char);
+		path_count = 0;
+		FOR_ADJ_ON(new_loc, xloc, j)
+		if (flow_on_path(f, cur_loc, total, xloc)) {
+			path_count += 1;
+		}
+
+		/* remember best location */
+		if (count > bestcount ||
+		    (count == bestcount && path_count > bestpath)) {
+			bestcount = count;
+			bestpath = path_count;
+			bestloc = new_loc;
+		}
+	}
+	return bestloc;
+}
+
+/*
+Routes to far destinations.
+
+'vmap_find_dest' floods outward until it reaches the destination, which
+is most of the map when the destination is far away.  For those we
+first plan over a much smaller graph.  The map is cut into clusters of
+CLUSTER_SIZE by CLUSTER_SIZE cells; the display sectors are far too
+big for this.  Where crossable cells face each other across the edge
+between two clusters we place entrances, and for each cluster we keep
+the number of moves between its entrances without leaving it.
+
+A route over that graph is not always a shortest one, but it is close,
+and we only use its first leg: the piece heads for the first entrance
+on the route outside the cluster it is in, using the usual search, and
+plans again on its next move.
+
+A graph is kept for each view map, owner and terrain, just as flow
+fields are.  A cluster is rebuilt when a cell in it or on its edge has
+changed (see 'vmap_changed').  Graphs are shared by every context, so
+only one thread may route at a time, but the scratch for searching a
+graph belongs to the context.
 */
 
-loc_t vmap_find_dest(path_map_t path_map[], view_map_t vmap[], loc_t cur_loc,
-                     loc_t dest_loc, int owner, int terrain)
-/* cur_loc = current location of piece */
-/* dest_loc = destination of piece */
-/* owner = owner of piece being moved */
-/* terrain = terrain we can cross */
-{
-	perimeter_t *from;
-	perimeter_t *to;
-	int cur_cost;
-	int start_terrain;
-	move_info_t move_info;
-	char old_contents;
-
-	old_contents = vmap[dest_loc].contents;
-	vmap[dest_loc].contents = '%'; /* mark objective */
-	move_info.city_owner = owner;
-	move_info.objectives = "%";
-	move_info.weights[0] = 1;
+#define CLUSTER_SIZE 10
+#define CLUSTER_ROWS ((MAP_HEIGHT + CLUSTER_SIZE - 1) / CLUSTER_SIZE)
+#define CLUSTER_COLS ((MAP_WIDTH + CLUSTER_SIZE - 1) / CLUSTER_SIZE)
+#define NUM_CLUSTERS (CLUSTER_ROWS * CLUSTER_COLS)
+
+/* an edge holds at most one entrance per two cells */
+#define CLUSTER_NODES (4 * ((CLUSTER_SIZE + 1) / 2))
+#define CLUSTER_CELLS (CLUSTER_SIZE * CLUSTER_SIZE)
+#define LONG_RUN 6 /* runs this long get an entrance at each end */
+
+#define NUM_GRAPHS 8 /* number of graphs we keep */
+
+#define ROUTE_NODES (NUM_CLUSTERS * CLUSTER_NODES + 2)
+#define ROUTE_START (ROUTE_NODES - 2) /* node for the piece */
+#define ROUTE_GOAL (ROUTE_NODES - 1)  /* node for the destination */
+
+typedef struct {
+	int num_nodes;                            /* number of entrances */
+	loc_t node[CLUSTER_NODES];                /* entrance cells */
+	short dist[CLUSTER_NODES][CLUSTER_NODES]; /* moves; -1 if none */
+	bool dirty;                               /* must be rebuilt */
+} cluster_t;
+
+typedef struct {
+	view_map_t *vmap;     /* map graph was built from; NULL if unused */
+	int owner;            /* owner of pieces using graph */
+	int terrain;          /* terrain pieces can cross */
+	unsigned long synced; /* change clock when last brought up to date */
+	long last_use;        /* when graph was last used */
+	cluster_t *cluster;   /* NUM_CLUSTERS of them */
+	short *node_at;       /* entrance number of a cell, or -1 */
+} route_graph_t;
+
+static route_graph_t graphs[NUM_GRAPHS];
+static long graph_clock;
+
+/* Return the cluster holding a location. */
+
+static int loc_cluster(loc_t loc) {
+	return loc_row(loc) / CLUSTER_SIZE * CLUSTER_COLS +
+	       loc_col(loc) / CLUSTER_SIZE;
+}
 
-	from = &p1;
-	to = &p2;
+/* Return true if a cell lies where a search may go. */
 
-	if (terrain == T_AIR) {
-		start_terrain = T_LAND;
-	} else {
-		start_terrain = terrain;
-	}
+static bool in_box(path_ctx_t *ctx, loc_t loc) {
+	return ctx->box < 0 || loc_cluster(loc) == ctx->box;
+}
 
-	start_perimeter(path_map, from, cur_loc, start_terrain);
-	cur_cost = 0; /* cost to reach current perimeter */
+/* Return true if pieces using a graph can cross a cell. */
 
-	for (;;) {
-		to->len = 0; /* nothing in perim yet */
-		expand_perimeter(path_map, vmap, &move_info, from, terrain,
-		                 cur_cost, 1, 1, to, to);
-		cur_cost += 1;
-		if (to->len == 0 || best_cost <= cur_cost) {
-			vmap[dest_loc].contents = old_contents;
-			return best_loc;
-		}
-		SWAP(from, to);
-	}
+static bool route_open(route_graph_t *g, loc_t loc) {
+	return game.real_map[loc].on_board &&
+	       flow_open(g->vmap, loc, g->owner, g->terrain);
 }
 
 /*
-Starting with the destination, we recursively back track toward the source
-marking all cells which are on a shortest path between the start and the
-destination.  To do this, we know the distance from the destination to
-the start.  The destination is on a path.  We then find the cells adjacent
-to the destination and nearest to the source and place them on the path.
-
-If we know square P is on the path, then S is on the path if S is
-adjacent to P, the cost to reach S is less than the cost to reach P,
-and the cost to move from S to P is the difference in cost between
-S and P.
-
-Someday, this routine should probably use perimeter lists as well.
+Moves from 'loc' to each entrance of its cluster, staying inside the
+cluster.  'loc' itself need not be crossable.  Unreached entrances get
+-1.
 */
 
-void vmap_mark_path(path_map_t *path_map, view_map_t *vmap, loc_t dest) {
-	int n;
-	loc_t new_dest;
+static void cluster_reach(route_graph_t *g, int c, loc_t loc, short *out) {
+	cluster_t *cl = &g->cluster[c];
+	int row0 = c / CLUSTER_COLS * CLUSTER_SIZE;
+	int col0 = c % CLUSTER_COLS * CLUSTER_SIZE;
+	short moves[CLUSTER_CELLS];
+	loc_t queue[CLUSTER_CELLS];
+	int head, tail;
+	int i, k;
+	loc_t new_loc;
 
-	if (path_map[dest].cost == 0) {
-		return; /* reached end of path */
+	for (i = 0; i < CLUSTER_CELLS; i++) {
+		moves[i] = -1;
 	}
-	if (path_map[dest].terrain == T_PATH) {
-		return; /* already marked */
+	moves[(loc_row(loc) - row0) * CLUSTER_SIZE + loc_col(loc) - col0] = 0;
+	queue[0] = loc;
+	head = 0;
+	tail = 1;
+
+	while (head < tail) {
+		loc_t cur = queue[head++];
+		int cur_moves = moves[(loc_row(cur) - row0) * CLUSTER_SIZE +
+		                      loc_col(cur) - col0];
+
+		FOR_ADJ_ON(cur, new_loc, i) {
+			int r = loc_row(new_loc) - row0;
+			int col = loc_col(new_loc) - col0;
+
+			if (r < 0 || r >= CLUSTER_SIZE || col < 0 ||
+			    col >= CLUSTER_SIZE ||
+			    moves[r * CLUSTER_SIZE + col] != -1 ||
+			    !route_open(g, new_loc)) {
+				continue;
+			}
+			moves[r * CLUSTER_SIZE + col] = cur_moves + 1;
+			queue[tail++] = new_loc;
+		}
 	}
-	path_map[dest].terrain = T_PATH; /* this square is on path */
+	for (k = 0; k < cl->num_nodes; k++) {
+		out[k] = moves[(loc_row(cl->node[k]) - row0) * CLUSTER_SIZE +
+		               loc_col(cl->node[k]) - col0];
+	}
+}
 
-	/* loop to mark adjacent squares on shortest path */
-	FOR_ADJ(dest, new_dest, n)
-	if (path_map[new_dest].cost ==
-	    path_map[dest].cost - path_map[dest].inc_cost) {
-		vmap_mark_path(path_map, vmap, new_dest);
+/* Add an entrance to a cluster unless it is already one. */
+
+static void cluster_add_node(route_graph_t *g, cluster_t *cl, loc_t loc) {
+	if (g->node_at[loc] != -1) {
+		return; /* a corner on two edges */
 	}
+	ASSERT(cl->num_nodes < CLUSTER_NODES);
+	g->node_at[loc] = cl->num_nodes;
+	cl->node[cl->num_nodes++] = loc;
 }
 
 /*
-Create a marked path map.  We mark those squares adjacent to the
-starting location which are on the board.  'find_dir' must be
-invoked to decide which squares are actually valid.
+Place the entrances on one edge of a cluster.  The edge has 'len'
+cells starting at 'first', 'step' apart, and 'across' takes a cell to
+the one facing it in the next cluster.  Each run of cells that can be
+crossed on both sides gets an entrance in its middle, or one at each
+end if it is long.
 */
 
-void vmap_mark_adjacent(path_map_t path_map[], loc_t loc) {
-	int i;
-	loc_t new_loc;
+static void cluster_edge(route_graph_t *g, cluster_t *cl, loc_t first,
+                         int step, int across, int len) {
+	int i, start;
+
+	start = -1;
+	for (i = 0; i <= len; i++) {
+		loc_t loc = first + i * step;
+		bool open = i < len && route_open(g, loc) &&
+		            route_open(g, loc + across);
+
+		if (open && start < 0) {
+			start = i;
+		} else if (!open && start >= 0) {
+			if (i - start >= LONG_RUN) {
+				cluster_add_node(g, cl, first + start * step);
+				cluster_add_node(g, cl, first + (i - 1) * step);
+			} else {
+				loc_t mid = first + (start + i - 1) / 2 * step;
+
+				cluster_add_node(g, cl, mid);
+			}
+			start = -1;
+		}
+	}
+}
 
-	FOR_ADJ_ON(loc, new_loc, i)
-	path_map[new_loc].terrain = T_PATH;
+/* Rebuild the entrances of a cluster and the moves between them. */
+
+static void cluster_build(route_graph_t *g, int c) {
+	cluster_t *cl = &g->cluster[c];
+	int crow = c / CLUSTER_COLS;
+	int ccol = c % CLUSTER_COLS;
+	int row0 = crow * CLUSTER_SIZE;
+	int col0 = ccol * CLUSTER_SIZE;
+	int rows = MAP_HEIGHT - row0 < CLUSTER_SIZE ? MAP_HEIGHT - row0
+	                                            : CLUSTER_SIZE;
+	int cols = MAP_WIDTH - col0 < CLUSTER_SIZE ? MAP_WIDTH - col0
+	                                          : CLUSTER_SIZE;
+	int k;
+
+	for (k = 0; k < cl->num_nodes; k++) {
+		g->node_at[cl->node[k]] = -1;
+	}
+	cl->num_nodes = 0;
+	cl->dirty = false;
+
+	if (crow > 0) { /* north edge */
+		cluster_edge(g, cl, row_col_loc(row0, col0), 1, -MAP_STRIDE,
+		             cols);
+	}
+	if (crow < CLUSTER_ROWS - 1) { /* south edge */
+		cluster_edge(g, cl, row_col_loc(row0 + rows - 1, col0), 1,
+		             MAP_STRIDE, cols);
+	}
+	if (ccol > 0) { /* west edge */
+		cluster_edge(g, cl, row_col_loc(row0, col0), MAP_STRIDE, -1,
+		             rows);
+	}
+	if (ccol < CLUSTER_COLS - 1) { /* east edge */
+		cluster_edge(g, cl, row_col_loc(row0, col0 + cols - 1),
+		             MAP_STRIDE, 1, rows);
+	}
+	for (k = 0; k < cl->num_nodes; k++) {
+		cluster_reach(g, c, cl->node[k], cl->dist[k]);
+	}
 }
 
 /*
-Modify a marked path map.  We mark those squares adjacent to the
-starting location which are on the board and which are adjacent
-to a location on the existing shortest path.
+Note that a cell changed.  The cluster holding it must be rebuilt, and
+so must a neighboring cluster if the cell is on the edge they share.
 */
 
-void vmap_mark_near_path(path_map_t path_map[], loc_t loc) {
-	int i, j;
-	loc_t new_loc, xloc;
-	int hit_loc[8];
+static void cluster_touch(route_graph_t *g, loc_t loc) {
+	int crow = loc_row(loc) / CLUSTER_SIZE;
+	int ccol = loc_col(loc) / CLUSTER_SIZE;
+	int r = loc_row(loc) % CLUSTER_SIZE;
+	int col = loc_col(loc) % CLUSTER_SIZE;
 
-	(void)memset((char *)hit_loc, '\0', sizeof(int) * 8);
+	g->cluster[crow * CLUSTER_COLS + ccol].dirty = true;
+	if (r == 0 && crow > 0) {
+		g->cluster[(crow - 1) * CLUSTER_COLS + ccol].dirty = true;
+	}
+	if (r == CLUSTER_SIZE - 1 && crow < CLUSTER_ROWS - 1) {
+		g->cluster[(crow + 1) * CLUSTER_COLS + ccol].dirty = true;
+	}
+	if (col == 0 && ccol > 0) {
+		g->cluster[crow * CLUSTER_COLS + ccol - 1].dirty = true;
+	}
+	if (col == CLUSTER_SIZE - 1 && ccol < CLUSTER_COLS - 1) {
+		g->cluster[crow * CLUSTER_COLS + ccol + 1].dirty = true;
+	}
+}
 
-	FOR_ADJ_ON(loc, new_loc, i) {
-		FOR_ADJ_ON(new_loc, xloc, j)
-		if (xloc != loc && path_map[xloc].terrain == T_PATH) {
-			hit_loc[i] = 1;
+/* Find the graph for a view map, building or updating it if need be. */
+
+static route_graph_t *route_get(view_map_t *vmap, int owner, int terrain) {
+	route_graph_t *g;
+	route_graph_t *victim;
+	unsigned long n;
+	int i;
+
+	victim = NULL;
+	for (i = 0; i < NUM_GRAPHS; i++) {
+		g = &graphs[i];
+		if (g->vmap == vmap && g->owner == owner &&
+		    g->terrain == terrain) {
 			break;
 		}
+		if (victim == NULL ||
+		    (victim->vmap != NULL &&
+		     (g->vmap == NULL || g->last_use < victim->last_use))) {
+			victim = g;
+		}
 	}
-	for (i = 0; i < 8; i++) {
-		if (hit_loc[i]) {
-			path_map[loc + dir_offset[i]].terrain = T_PATH;
+	if (i == NUM_GRAPHS) { /* build a new graph */
+		g = victim;
+		g->vmap = vmap;
+		g->owner = owner;
+		g->terrain = terrain;
+		g->synced = change_clock - CHANGE_RING - 1;
+		for (i = 0; i < MAP_SIZE; i++) {
+			g->node_at[i] = -1;
+		}
+		for (i = 0; i < NUM_CLUSTERS; i++) {
+			g->cluster[i].num_nodes = 0;
 		}
 	}
+	g->last_use = ++graph_clock;
+
+	if (change_clock - g->synced > CHANGE_RING) {
+		for (i = 0; i < NUM_CLUSTERS; i++) {
+			g->cluster[i].dirty = true;
+		}
+	} else {
+		for (n = g->synced; n != change_clock; n++) {
+			cluster_touch(g, change_ring[n % CHANGE_RING]);
+		}
+	}
+	g->synced = change_clock;
+
+	for (i = 0; i < NUM_CLUSTERS; i++) {
+		if (g->cluster[i].dirty) {
+			cluster_build(g, i);
+		}
+	}
+	return g;
 }
 
-/*
-Look at each neighbor of 'loc'.  Select the first marked cell which
-is on a short path to the desired destination, and which holds a valid
-terrain.  Note that while this terrain is matched against a 'vmap',
-it differs slightly from terrains used above.  This terrain is the
-terrain to which we can move immediately, and does not include terrain
-for which we would have to wait for another piece to move off of.
+/* Return the cell standing for a node of a graph. */
 
-We prefer diagonal moves, and we try to have as many squares
-as possible containing something in 'adj_char'.
+static loc_t route_node_loc(route_graph_t *g, int node, loc_t from,
+                            loc_t dest) {
+	if (node == ROUTE_START) {
+		return from;
+	}
+	if (node == ROUTE_GOAL) {
+		return dest;
+	}
+	return g->cluster[node / CLUSTER_NODES].node[node % CLUSTER_NODES];
+}
 
-For tie-breaking, we prefer moving to cells that are adjacent to
-as many other squares on the path.  This should have a few benefits:
+/* Move a node up the heap to its place. */
 
-1)  Fighters are less likely to be blocked from reaching a city
-because they stay in the center of the path and increase the number
-of options for subsequent moves.
+static void heap_up(route_scratch_t *r, int i) {
+	int node = r->heap[i];
 
-2)  Transports will approach a city so that as many armies
-as possible can hop off the tt on one turn to take a valid
-path toward the city.
+	while (i > 0 && r->est[r->heap[(i - 1) / 2]] > r->est[node]) {
+		r->heap[i] = r->heap[(i - 1) / 2];
+		r->heap_at[r->heap[i]] = i;
+		i = (i - 1) / 2;
+	}
+	r->heap[i] = node;
+	r->heap_at[node] = i;
+}
 
-3)  User pieces will move more intuitively by staying in the
-center of the best path.
-*/
+/* Take the node with the lowest estimate off the heap. */
 
-static int order[] = {NORTHWEST, NORTHEAST, SOUTHWEST, SOUTHEAST,
-                      WEST,      EAST,      NORTH,     SOUTH};
+static int heap_pop(route_scratch_t *r) {
+	int top = r->heap[0];
+	int node = r->heap[--r->heap_len];
+	int i = 0;
 
-loc_t vmap_find_dir(path_map_t path_map[], view_map_t *vmap, loc_t loc,
-                    char *terrain, char *adj_char) {
-	int i, count, bestcount;
-	loc_t bestloc;
-	int path_count, bestpath;
-	char *p;
+	r->heap_at[top] = -1;
+	if (r->heap_len == 0) {
+		return top;
+	}
+	for (;;) {
+		int child = 2 * i + 1;
 
-	if (game.trace_pmap) {
-		print_pzoom("Before vmap_find_dir:", path_map, vmap);
+		if (child >= r->heap_len) {
+			break;
+		}
+		if (child + 1 < r->heap_len &&
+		    r->est[r->heap[child + 1]] < r->est[r->heap[child]]) {
+			child += 1;
+		}
+		if (r->est[r->heap[child]] >= r->est[node]) {
+			break;
+		}
+		r->heap[i] = r->heap[child];
+		r->heap_at[r->heap[i]] = i;
+		i = child;
 	}
+	r->heap[i] = node;
+	r->heap_at[node] = i;
+	return top;
+}
 
-	bestcount = -INFINITY; /* no best yet */
-	bestpath = -1;
-	bestloc = loc;
+/* Reach a node at a given cost if that is cheaper than before. */
 
-	for (i = 0; i < 8; i++) { /* for each adjacent square */
-		loc_t new_loc = loc + dir_offset[order[i]];
-		if (path_map[new_loc].terrain ==
-		    T_PATH) { /* which is on path */
-			p = strchr(terrain, vmap[new_loc].contents);
+static void route_relax(route_scratch_t *r, int node, int from_node, int cost,
+                        int to_go) {
+	if (r->seen[node] == r->gen && r->cost[node] <= cost) {
+		return;
+	}
+	if (r->seen[node] != r->gen) {
+		r->seen[node] = r->gen;
+		r->heap_at[node] = -1;
+	}
+	r->cost[node] = cost;
+	r->est[node] = cost + to_go;
+	r->from[node] = from_node;
+	if (r->heap_at[node] == -1) {
+		r->heap[r->heap_len] = node;
+		r->heap_len += 1;
+	}
+	heap_up(r, r->heap_at[node] == -1 ? r->heap_len - 1
+	                                     : r->heap_at[node]);
+}
 
-			if (p != NULL) { /* desirable square? */
-				count = vmap_count_adjacent(vmap, new_loc,
-				                            adj_char);
-				path_count = vmap_count_path(path_map, new_loc);
+/*
+Return true if 'vmap_find_dest' routes from 'from' to 'dest' over
+clusters, because at least one cluster lies between them.  Pieces in
+the air do not need to: their paths are nearly straight, so the search
+already looks at few cells beyond them, and a longer route could leave
+a fighter short of fuel.
+*/
 
-				/* remember best location */
-				if (count > bestcount ||
-				    (count == bestcount &&
-				     path_count > bestpath)) {
-					bestcount = count;
-					bestpath = path_count;
-					bestloc = new_loc;
-				}
-			}
-		}
+bool vmap_route_far(loc_t from, loc_t dest, int terrain) {
+	int from_cluster, dest_cluster;
+	int drow, dcol;
+
+	if (terrain == T_AIR) {
+		return false;
 	}
-	return (bestloc);
+	from_cluster = loc_cluster(from);
+	dest_cluster = loc_cluster(dest);
+	drow = from_cluster / CLUSTER_COLS - dest_cluster / CLUSTER_COLS;
+	dcol = from_cluster % CLUSTER_COLS - dest_cluster % CLUSTER_COLS;
+	return abs(drow) >= 2 || abs(dcol) >= 2;
 }
 
 /*
-Count the number of adjacent squares of interest.
-Squares are weighted so that the first in the list
-is the most interesting.
+Pick where a piece heading for a far destination should go next: the
+first entrance on a route over the graph that lies outside the
+piece's cluster.  We return the destination itself if the graph finds
+no route, and leave it to the full search.
 */
 
-int vmap_count_adjacent(view_map_t *vmap, loc_t loc, char *adj_char) {
-	int i, count;
+static loc_t route_waypoint(path_ctx_t *ctx, view_map_t *vmap, loc_t from,
+                            loc_t dest, int owner, int terrain) {
+	route_scratch_t *r = &ctx->route;
+	route_graph_t *g;
+	int from_cluster, dest_cluster;
+	short from_moves[CLUSTER_NODES];
+	short dest_moves[CLUSTER_NODES];
+	int node, next;
+	int i, k;
 	loc_t new_loc;
-	char *p;
-	int len;
 
-	len = strlen(adj_char);
+	from_cluster = loc_cluster(from);
+	dest_cluster = loc_cluster(dest);
+	g = route_get(vmap, owner, terrain);
+	cluster_reach(g, from_cluster, from, from_moves);
+	cluster_reach(g, dest_cluster, dest, dest_moves);
 
-	count = 0;
+	r->gen += 1;
+	r->heap_len = 0;
+	route_relax(r, ROUTE_START, -1, 0, dist(from, dest));
 
-	FOR_ADJ_ON(loc, new_loc, i) {
-		p = strchr(adj_char, vmap[new_loc].contents);
-		if (p) {
-			count += 8 * (len - (p - adj_char));
+	while (r->heap_len > 0) {
+		cluster_t *cl;
+		int c, cost;
+		loc_t loc;
+
+		node = heap_pop(r);
+		cost = r->cost[node];
+		if (node == ROUTE_GOAL) {
+			break;
+		}
+		if (node == ROUTE_START) {
+			cl = &g->cluster[from_cluster];
+			for (k = 0; k < cl->num_nodes; k++) {
+				if (from_moves[k] < 0) {
+					continue;
+				}
+				next = from_cluster * CLUSTER_NODES + k;
+				route_relax(r, next, node, from_moves[k],
+				            dist(cl->node[k], dest));
+			}
+			continue;
+		}
+		c = node / CLUSTER_NODES;
+		k = node % CLUSTER_NODES;
+		cl = &g->cluster[c];
+		loc = cl->node[k];
+
+		for (i = 0; i < cl->num_nodes; i++) { /* across the cluster */
+			if (i != k && cl->dist[k][i] >= 0) {
+				route_relax(r, c * CLUSTER_NODES + i, node,
+				            cost + cl->dist[k][i],
+				            dist(cl->node[i], dest));
+			}
+		}
+		FOR_ADJ_ON(loc, new_loc, i) { /* into the next cluster */
+			if (g->node_at[new_loc] == -1 ||
+			    loc_cluster(new_loc) == c) {
+				continue;
+			}
+			next = loc_cluster(new_loc) * CLUSTER_NODES +
+			       g->node_at[new_loc];
+			route_relax(r, next, node, cost + 1,
+			            dist(new_loc, dest));
+		}
+		if (c == dest_cluster && dest_moves[k] >= 0) {
+			route_relax(r, ROUTE_GOAL, node,
+			            cost + dest_moves[k], 0);
 		}
 	}
-	return (count);
+	if (r->seen[ROUTE_GOAL] != r->gen) {
+		return dest; /* no route found */
+	}
+	/* walk back to the first node outside our cluster */
+	next = ROUTE_GOAL;
+	for (node = r->from[ROUTE_GOAL]; node != ROUTE_START;
+	     node = r->from[node]) {
+		if (node / CLUSTER_NODES != from_cluster) {
+			next = node;
+		}
+	}
+	return route_node_loc(g, next, from, dest);
 }
 
 /*
-   Count the number of adjacent cells that are on the path.
- */
+Note that something at a location changed: either the contents of a
+view map cell or the owner of a city.  We log the change, and whatever
+was worked out from the maps looks at it when next used.
+*/
 
-int vmap_count_path(path_map_t *pmap, loc_t loc) {
-	int i, count;
-	loc_t new_loc;
+void vmap_changed(loc_t loc) {
+	change_ring[change_clock % CHANGE_RING] = loc;
+	change_clock += 1;
+}
 
-	count = 0;
+/*
+Note that any cell may have changed, as when a game is started or
+restored.  Everything kept about the view maps is thrown away.
+*/
 
-	FOR_ADJ_ON(loc, new_loc, i)
-	if (pmap[new_loc].terrain == T_PATH) {
-		count += 1;
+void vmap_forget(void) {
+	change_clock += CHANGE_RING + 1; /* too many changes to look at */
+}
+
+/* Return the change clock. */
+
+unsigned long vmap_change_clock(void) { return change_clock; }
+
+/*
+List the cells noted as changed since the change clock read 'since'.
+A cell may be listed more than once.  We return false if we no longer
+know what changed.
+*/
+
+bool vmap_changes(unsigned long since, perimeter_t *list) {
+	unsigned long n;
+
+	if (change_clock - since > CHANGE_RING) {
+		return false;
+	}
+	list->len = 0;
+	for (n = since; n != change_clock; n++) {
+		list->list[list->len++] = change_ring[n % CHANGE_RING];
 	}
+	return true;
+}
 
-	return (count);
+/*
+Return true if a change noted after the change clock read 'since'
+could alter the search that filled in a path map.  A search only
+looks at the cells it brought into the path map's generation and at
+their neighbors.
+*/
+
+bool vmap_path_changed(path_map_t *pmap, unsigned long since) {
+	unsigned long n;
+	loc_t loc, new_loc;
+	int i;
+
+	if (change_clock - since > CHANGE_RING) {
+		return true; /* we no longer know what changed */
+	}
+	for (n = since; n != change_clock; n++) {
+		loc = change_ring[n % CHANGE_RING];
+		if (PMAP_VALID(pmap, loc)) {
+			return true;
+		}
+		FOR_ADJ_ON(loc, new_loc, i) {
+			if (PMAP_VALID(pmap, new_loc)) {
+				return true;
+			}
+		}
+	}
+	return false;
 }
 
 /*
@@ -1225,4 +3362,68 @@ bool rmap_at_sea(loc_t loc) {
 	return (true);
 }
 
+/* Make room in a search context for the current map. */
+
+void size_path_ctx(path_ctx_t *ctx) {
+	int i;
+
+	for (i = 0; i < NUM_PERIMS; i++) {
+		RESIZE(ctx->perim[i].list, MAP_SIZE);
+		ctx->perim[i].len = 0;
+	}
+	RESIZE(ctx->bucket_link, MAP_SIZE);
+	for (i = 0; i < NUM_PLANES; i++) {
+		bit_planes_t *bp = &ctx->planes[i];
+
+		RESIZE(bp->made, MAP_HEIGHT);
+		RESIZE(bp->pass, MAP_HEIGHT);
+		RESIZE(bp->stop, MAP_HEIGHT);
+		RESIZE(bp->wet, MAP_HEIGHT);
+		RESIZE(bp->goal, MAP_HEIGHT);
+		bp->vmap = NULL;
+	}
+	RESIZE(ctx->seen, MAP_HEIGHT);
+	RESIZE(ctx->front, MAP_HEIGHT);
+	RESIZE(ctx->next, MAP_HEIGHT);
+	RESIZE(ctx->spread, MAP_HEIGHT);
+	RESIZE(ctx->cand, MAP_HEIGHT);
+	RESIZE(ctx->listed, MAP_HEIGHT);
+	RESIZE(ctx->path_map, MAP_SIZE);
+	RESIZE(ctx->path_map2, MAP_SIZE);
+	RESIZE(ctx->scratch, MAP_SIZE);
+	RESIZE(ctx->route.cost, ROUTE_NODES);
+	RESIZE(ctx->route.est, ROUTE_NODES);
+	RESIZE(ctx->route.from, ROUTE_NODES);
+	RESIZE(ctx->route.seen, ROUTE_NODES);
+	RESIZE(ctx->route.heap, ROUTE_NODES);
+	RESIZE(ctx->route.heap_at, ROUTE_NODES);
+	for (i = 0; i < NUM_FLOWS; i++) {
+		flow_field_t *f = &ctx->flows[i];
+
+		free(f->dist); /* made again when first used */
+		free(f->state);
+		f->dist = NULL;
+		f->state = NULL;
+		f->vmap = NULL;
+	}
+}
+
+/*
+Make room in the searches' own tables for the current map.  Whatever
+graphs were kept are thrown away.
+*/
+
+void size_search_maps(void) {
+	int i;
+
+	RESIZE(cont_root, MAP_SIZE);
+	RESIZE(cont_mark, MAP_SIZE);
+	RESIZE(prune_pmap, MAP_SIZE);
+	for (i = 0; i < NUM_GRAPHS; i++) {
+		RESIZE(graphs[i].cluster, NUM_CLUSTERS);
+		RESIZE(graphs[i].node_at, MAP_SIZE);
+		graphs[i].vmap = NULL;
+	}
+}
+
 /* end */
@@ -18,6 +18,13 @@ object.c -- routines for manipulating objects.
 #include <stdlib.h>
 
 extern int get_piece_name(void);
+static void show_cell(loc_t loc);
+static void watch_piece(piece_info_t *obj, loc_t loc, int delta);
+static void watch_city(city_info_t *cityp, int delta);
+
+static long pool_live;              /* pieces in play */
+static long pool_peak;              /* most pieces in play at once */
+static long pool_type[NUM_OBJECTS]; /* pieces in play by type */
 
 /*
 Find the nearest city to a location.  Return the location
@@ -26,21 +33,22 @@ Distances are computed as straight-line distances.
 */
 
 int find_nearest_city(loc_t loc, int owner, loc_t *city_loc) {
+	city_set_t *cs = &game.owned[owner];
 	loc_t best_loc;
 	long best_dist;
-	long new_dist, i;
+	long new_dist, i, k;
 
 	best_dist = INFINITY;
 	best_loc = loc;
 
-	for (i = 0; i < NUM_CITY; i++)
-		if (game.city[i].owner == owner) {
-			new_dist = dist(loc, game.city[i].loc);
-			if (new_dist < best_dist) {
-				best_dist = new_dist;
-				best_loc = game.city[i].loc;
-			}
+	for (k = 0; k < cs->count; k++) {
+		i = cs->index[k];
+		new_dist = dist(loc, game.city[i].loc);
+		if (new_dist < best_dist) {
+			best_dist = new_dist;
+			best_loc = game.city[i].loc;
 		}
+	}
 	*city_loc = best_loc;
 	return best_dist;
 }
@@ -84,7 +92,7 @@ list of objects at the given location for one of the given type.
 piece_info_t *find_obj(int type, loc_t loc) {
 	piece_info_t *p;
 
-	for (p = game.real_map[loc].objp; p != NULL; p = p->loc_link.next)
+	for (p = game.real_map[loc].objp; p != NULL; p = NEXT(p, loc_link))
 		if (p->type == type)
 			return (p);
 
@@ -98,7 +106,7 @@ Find a non-full item of the appropriate type at the given location.
 piece_info_t *find_nfull(int type, loc_t loc) {
 	piece_info_t *p;
 
-	for (p = game.real_map[loc].objp; p != NULL; p = p->loc_link.next)
+	for (p = game.real_map[loc].objp; p != NULL; p = NEXT(p, loc_link))
 		if (p->type == type) {
 			if (obj_capacity(p) > p->count)
 				return (p);
@@ -125,21 +133,27 @@ loc_t find_transport(int owner, loc_t loc) {
 
 /*
 Search a list of objects at a location for any kind of object.
-We prefer transports and carriers to other objects.
+We prefer transports and carriers to other objects.  The choice is
+made whenever the list changes and kept with the cell, since it is
+wanted for every cell scanned or drawn.
 */
 
-piece_info_t *find_obj_at_loc(loc_t loc) {
+void stack_changed(loc_t loc) {
 	piece_info_t *p, *best;
 
 	best = game.real_map[loc].objp;
-	if (best == NULL)
-		return (NULL); /* nothing here */
-
-	for (p = best->loc_link.next; p != NULL; p = p->loc_link.next)
-		if (p->type > best->type && p->type != SATELLITE)
-			best = p;
+	if (best != NULL) {
+		for (p = NEXT(best, loc_link); p != NULL;
+		     p = NEXT(p, loc_link))
+			if (p->type > best->type && p->type != SATELLITE)
+				best = p;
+	}
+	game.real_map[loc].top = best;
+	show_cell(loc);
+}
 
-	return (best);
+piece_info_t *find_obj_at_loc(loc_t loc) {
+	return (game.real_map[loc].top);
 }
 
 /*
@@ -148,9 +162,10 @@ If an object is on a ship, remove it from that ship.
 
 void disembark(piece_info_t *obj) {
 	if (obj->ship) {
-		UNLINK(obj->ship->cargo, obj, cargo_link);
-		obj->ship->count -= 1;
-		obj->ship = NULL;
+		piece_info_t *ship = SHIP(obj);
+		UNLINK(ship->cargo, obj, cargo_link);
+		ship->count -= 1;
+		obj->ship = 0;
 	}
 }
 
@@ -159,11 +174,55 @@ Move an object onto a ship.
 */
 
 void embark(piece_info_t *ship, piece_info_t *obj) {
-	obj->ship = ship;
+	obj->ship = PIECE_ID(ship);
 	LINK(ship->cargo, obj, cargo_link);
 	ship->count += 1;
 }
 
+/*
+Each owner's pieces are also listed by sector and type, so that
+user_move can visit the pieces in one sector without walking them
+all.  A piece enters the list for its owner and location when it is
+built and leaves it when it dies, changes owner, or crosses into
+another sector.
+
+A sector list keeps its pieces in the order of the piece list, so
+they are moved in the order they were before.  A piece goes in after
+the nearest newer piece in the same sector, which we find by walking
+back up the piece list.  A piece just put at the head of the piece
+list goes at the head of the sector list.
+*/
+
+void enter_sector(piece_info_t *obj) {
+	piece_info_t **list;
+	piece_info_t *p;
+	int sector = loc_sector(obj->loc);
+
+	list = game.sector_obj[obj->owner][sector];
+	for (p = PREV(obj, piece_link); p != NULL; p = PREV(p, piece_link)) {
+		if (loc_sector(p->loc) == sector) {
+			break;
+		}
+	}
+	if (p == NULL) {
+		LINK(list[obj->type], obj, sector_link);
+		return;
+	}
+	obj->sector_link.prev = PIECE_ID(p);
+	obj->sector_link.next = p->sector_link.next;
+	if (p->sector_link.next) {
+		NEXT(p, sector_link)->sector_link.prev = PIECE_ID(obj);
+	}
+	p->sector_link.next = PIECE_ID(obj);
+}
+
+void leave_sector(piece_info_t *obj) {
+	piece_info_t **list;
+
+	list = game.sector_obj[obj->owner][loc_sector(obj->loc)];
+	UNLINK(list[obj->type], obj, sector_link);
+}
+
 /*
 Kill an object.  We scan around the piece and free it.  If there is
 anything in the object, it is killed as well.
@@ -188,14 +247,70 @@ void kill_obj(piece_info_t *obj, loc_t loc) {
 /* kill an object without scanning */
 
 void kill_one(piece_info_t **list, piece_info_t *obj) {
+	leave_sector(obj);
 	UNLINK(list[obj->type], obj,
 	       piece_link); /* unlink obj from all lists */
 	UNLINK(game.real_map[obj->loc].objp, obj, loc_link);
+	stack_changed(obj->loc);
+	watch_piece(obj, obj->loc, -1);
 	disembark(obj);
 
 	LINK(game.free_list, obj, piece_link); /* return object to free list */
 	obj->hits = 0; /* let all know this object is dead */
 	obj->moved = piece_attr[obj->type].speed; /* object has moved */
+	pool_live -= 1;
+	pool_type[obj->type] -= 1;
+}
+
+/*
+Give a city to a new owner, keeping the owners' city sets in step.
+Each set is kept in index order, so walking a set visits its cities
+in the same order as walking game.city.
+*/
+
+void set_city_owner(city_info_t *cityp, int owner) {
+	city_set_t *cs;
+	int id = cityp - game.city;
+	int i;
+
+	if (cityp->owner == owner) {
+		return;
+	}
+	cs = &game.owned[cityp->owner];
+	for (i = 0; i < cs->count && cs->index[i] != id; i++) {
+		;
+	}
+	ASSERT(i < cs->count);
+	cs->count -= 1;
+	(void)memmove(&cs->index[i], &cs->index[i + 1],
+	              (cs->count - i) * sizeof(cs->index[0]));
+
+	cs = &game.owned[owner];
+	for (i = cs->count; i > 0 && cs->index[i - 1] > id; i--) {
+		cs->index[i] = cs->index[i - 1];
+	}
+	cs->index[i] = id;
+	cs->count += 1;
+	watch_city(cityp, -1);
+	cityp->owner = owner;
+	watch_city(cityp, 1);
+	show_cell(cityp->loc);
+}
+
+/*
+Rebuild the city sets from scratch for a new or restored game.
+*/
+
+void index_cities(void) {
+	int i;
+
+	for (i = 0; i < NUM_OWNERS; i++) {
+		game.owned[i].count = 0;
+	}
+	for (i = 0; i < NUM_CITY; i++) {
+		city_set_t *cs = &game.owned[game.city[i].owner];
+		cs->index[cs->count++] = i;
+	}
 }
 
 /*
@@ -210,7 +325,7 @@ void kill_city(city_info_t *cityp) {
 
 	/* change ownership of hardware at this location; but not satellites */
 	for (p = game.real_map[cityp->loc].objp; p; p = next_p) {
-		next_p = p->loc_link.next;
+		next_p = NEXT(p, loc_link);
 
 		if (p->type == ARMY)
 			kill_obj(p, cityp->loc);
@@ -223,6 +338,8 @@ void kill_city(city_info_t *cityp) {
 			}
 			list = LIST(p->owner);
 			UNLINK(list[p->type], p, piece_link);
+			leave_sector(p);
+			watch_piece(p, p->loc, -1);
 			if (p->owner == USER)
 				p->owner = COMP;
 			else if (p->owner == COMP)
@@ -231,6 +348,8 @@ void kill_city(city_info_t *cityp) {
 				p->owner = COMP; /* Human units become computer when city captured */
 			list = LIST(p->owner);
 			LINK(list[p->type], p, piece_link);
+			enter_sector(p);
+			watch_piece(p, p->loc, 1);
 
 			p->func = NOFUNC;
 		}
@@ -239,9 +358,10 @@ void kill_city(city_info_t *cityp) {
 	if (cityp->owner != UNOWNED) {
 		view_map_t *vmap = MAP(cityp->owner);
 		int i;
-		cityp->owner = UNOWNED;
+		set_city_owner(cityp, UNOWNED);
 		cityp->work = 0;
 		cityp->prod = NOPIECE;
+		vmap_changed(cityp->loc);
 
 		for (i = 0; i < NUM_OBJECTS; i++)
 			cityp->func[i] = NOFUNC;
@@ -256,6 +376,52 @@ Produce an item for a city.
 
 static int sat_dir[4] = {MOVE_NW, MOVE_SW, MOVE_NE, MOVE_SE};
 
+/*
+Make sure the pool has slabs enough for 'size' pieces.  Slabs are
+allocated separately and never freed or moved, so ship and cargo
+pointers stay good as the pool grows; only the table of slabs is
+reallocated.  Each piece is given its id as its slab is made.
+*/
+
+void size_pool(long size) {
+	long need = (size + SLAB_SIZE - 1) / SLAB_SIZE;
+	long i;
+
+	if (need <= game.num_slabs) {
+		return;
+	}
+	game.slab = grow_array(game.slab, game.num_slabs, need,
+	                       sizeof(*game.slab));
+	for (; game.num_slabs < need; game.num_slabs++) {
+		RESIZE(game.slab[game.num_slabs], SLAB_SIZE);
+		for (i = 0; i < SLAB_SIZE; i++) {
+			game.slab[game.num_slabs][i].id =
+			    game.num_slabs * SLAB_SIZE + i + 1;
+		}
+	}
+}
+
+/*
+Add pieces to the pool when the free list runs dry, up to the end of
+the next slab.  The new pieces are linked top down, so they are handed
+out in id order; freed pieces go on the front of the free list and are
+reused first, while they are still in the cache.
+*/
+
+static void grow_pool(void) {
+	count_t i, top;
+
+	top = (LIST_SIZE / SLAB_SIZE + 1) * SLAB_SIZE;
+	size_pool(top);
+	for (i = top; i-- > LIST_SIZE;) {
+		piece_info_t *obj = PIECE(i + 1);
+		obj->hits = 0;
+		obj->owner = UNOWNED;
+		LINK(game.free_list, obj, piece_link);
+	}
+	game.list_size = top;
+}
+
 void produce(city_info_t *cityp) {
 	piece_info_t **list;
 	piece_info_t *new;
@@ -264,13 +430,16 @@ void produce(city_info_t *cityp) {
 
 	cityp->work -= piece_attr[(int)cityp->prod].build_time;
 
+	if (game.free_list == NULL) {
+		grow_pool();
+	}
 	ASSERT(game.free_list); /* can we allocate? */
 	new = game.free_list;
 	UNLINK(game.free_list, new, piece_link);
 	LINK(list[(int)cityp->prod], new, piece_link);
 	LINK(game.real_map[cityp->loc].objp, new, loc_link);
-	new->cargo_link.next = NULL;
-	new->cargo_link.prev = NULL;
+	new->cargo_link.next = 0;
+	new->cargo_link.prev = 0;
 
 	new->loc = cityp->loc;
 	new->func = NOFUNC;
@@ -279,7 +448,7 @@ void produce(city_info_t *cityp) {
 	new->type = cityp->prod;
 	new->moved = 0;
 	new->cargo = NULL;
-	new->ship = NULL;
+	new->ship = 0;
 	new->count = 0;
 	new->range = piece_attr[(int)cityp->prod].range;
 	new->entrenched = false;
@@ -287,11 +456,60 @@ void produce(city_info_t *cityp) {
 	if (new->type == SATELLITE) { /* set random move direction */
 		new->func = sat_dir[irand(4)];
 	}
+	enter_sector(new);
+	stack_changed(new->loc);
+	watch_piece(new, new->loc, 1);
+	pool_live += 1;
+	pool_type[new->type] += 1;
+	if (pool_live > pool_peak) {
+		pool_peak = pool_live;
+	}
+}
+
+/*
+Recount the pieces in play after the pool has been built afresh by
+a new or restored game.
+*/
+
+void count_pool(void) {
+	count_t i;
+
+	pool_live = 0;
+	for (i = 0; i < NUM_OBJECTS; i++) {
+		pool_type[i] = 0;
+	}
+	for (i = 0; i < LIST_SIZE; i++) {
+		piece_info_t *obj = PIECE(i + 1);
+		if (obj->owner != UNOWNED && obj->hits > 0) {
+			pool_live += 1;
+			pool_type[obj->type] += 1;
+		}
+	}
+	pool_peak = pool_live;
+}
+
+/*
+Report how full the piece pool is.
+*/
+
+void describe_pool(void) {
+	char types[STRSIZE];
+	char *cur = types;
+	size_t rem = sizeof(types);
+	int i;
+
+	types[0] = 0;
+	for (i = 0; i < NUM_OBJECTS; i++) {
+		(void)buf_append(&cur, &rem, " %c:%ld", piece_attr[i].sname,
+		                 pool_type[i]);
+	}
+	prompt("Pieces: %ld live, %ld peak, %d slots in %ld slabs;%s",
+	       pool_live, pool_peak, LIST_SIZE, game.num_slabs, types);
 }
 
 /*
 Move an object to a location.  We mark the object moved, we move
-the object to the new square, and we scan around the object.
+the object to the new square, and its owner's sight moves with it.
 We also do lots of little maintenance like updating the range
 of an object, keeping track of the number of pieces on a boat,
 etc.
@@ -301,11 +519,16 @@ void move_obj(piece_info_t *obj, loc_t new_loc) {
 	view_map_t *vmap;
 	loc_t old_loc;
 	piece_info_t *p;
+	bool new_sector;
 
 	ASSERT(obj->hits);
 	vmap = MAP(obj->owner);
 
 	old_loc = obj->loc; /* save original location */
+	new_sector = (loc_sector(old_loc) != loc_sector(new_loc));
+	if (new_sector) {
+		leave_sector(obj);
+	}
 	obj->moved += 1;
 	obj->loc = new_loc;
 	obj->range--;
@@ -317,12 +540,32 @@ void move_obj(piece_info_t *obj, loc_t new_loc) {
 
 	UNLINK(game.real_map[old_loc].objp, obj, loc_link);
 	LINK(game.real_map[new_loc].objp, obj, loc_link);
+	if (new_sector) {
+		enter_sector(obj);
+	}
 
 	/* move any objects contained in object */
-	for (p = obj->cargo; p != NULL; p = p->cargo_link.next) {
+	for (p = obj->cargo; p != NULL; p = NEXT(p, cargo_link)) {
+		if (new_sector) {
+			leave_sector(p);
+		}
 		p->loc = new_loc;
 		UNLINK(game.real_map[old_loc].objp, p, loc_link);
 		LINK(game.real_map[new_loc].objp, p, loc_link);
+		if (new_sector) {
+			enter_sector(p);
+		}
+	}
+	stack_changed(old_loc);
+	stack_changed(new_loc);
+
+	/* watch from the new square before letting go of the old one, so
+	   cells both can see are not brought up to date twice */
+	watch_piece(obj, new_loc, 1);
+	watch_piece(obj, old_loc, -1);
+	for (p = obj->cargo; p != NULL; p = NEXT(p, cargo_link)) {
+		watch_piece(p, new_loc, 1);
+		watch_piece(p, old_loc, -1);
 	}
 
 	switch (obj->type) { /* board new ship */
@@ -345,7 +588,6 @@ void move_obj(piece_info_t *obj, loc_t new_loc) {
 
 	if (obj->type == SATELLITE)
 		scan_sat(vmap, obj->loc);
-	scan(vmap, obj->loc);
 }
 
 /*
@@ -423,7 +665,7 @@ static void satellite_aoe(piece_info_t *sat, loc_t loc) {
 			continue;
 		
 /* Damage enemy pieces */
-		for (p = game.real_map[i].objp; p != NULL; p = p->loc_link.next) {
+		for (p = game.real_map[i].objp; p != NULL; p = NEXT(p, loc_link)) {
 			if (p->owner != sat->owner && p->owner != UNOWNED) {
 				/* Satellite AOE does 1 damage to all enemy units */
 				p->hits -= 1;
@@ -571,50 +813,54 @@ void scan(view_map_t vmap[], loc_t loc) {
 	update(vmap, loc); /* update current location as well */
 }
 
+/*
+Note that a player has looked at a cell this turn.  The dates live in a
+plane of their own next to each player's view map.
+*/
+
+static void mark_seen(view_map_t vmap[], loc_t loc) {
+	if (vmap == game.comp_map)
+		game.comp_seen[loc] = (seen_t)game.date;
+	else if (vmap == game.user_map)
+		game.user_seen[loc] = (seen_t)game.date;
+}
+
 /*
 Scan a portion of the board for a satellite.
 Satellites now scan a much larger area (radius 7) to justify their cost.
-They reveal all terrain and cities in the recon area.
+They reveal all terrain and cities in the recon area.  The cells
+close to the satellite are watched like any other piece's; see
+'watch_piece'.  Watched cells are already up to date, so the terrain
+pass leaves them alone rather than hiding what is on them.
 */
 
 void scan_sat(view_map_t vmap[], loc_t loc) {
 int i, j;
+sight_t *sight = (vmap == game.comp_map) ? game.comp_sight : game.user_sight;
 
 ASSERT(game.real_map[loc].on_board);
 
 /* Scan wider area (radius 7) for satellite recon - reveals terrain */
 for (i = -7; i <= 7; i++) {
 	for (j = -7; j <= 7; j++) {
-		loc_t xloc = loc + i * MAP_WIDTH + j;
-		if (xloc >= 0 && xloc < MAP_SIZE && game.real_map[xloc].on_board) {
+		loc_t xloc = loc + i * MAP_STRIDE + j;
+		if (xloc >= 0 && xloc < MAP_SIZE && game.real_map[xloc].on_board
+		    && sight[xloc] == 0) {
 			if (abs(i) <= 5 && abs(j) <= 5) { /* box pattern for performance */
 				/* Reveal terrain */
 				if (game.real_map[xloc].contents == MAP_LAND ||
 				    game.real_map[xloc].contents == MAP_SEA ||
 				    game.real_map[xloc].contents == MAP_CITY) {
-					vmap[xloc].contents = game.real_map[xloc].contents;
-					vmap[xloc].seen = game.date;
+					if (vmap[xloc].contents != game.real_map[xloc].contents) {
+						vmap[xloc].contents = game.real_map[xloc].contents;
+						vmap_changed(xloc);
+					}
+					mark_seen(vmap, xloc);
 				}
 			}
 		}
 	}
 }
-
-/* Scan immediate surroundings thoroughly (radius 1-2) */
-for (i = 0; i < 8; i++) {
-	loc_t xloc = loc + dir_offset[i];
-	if (xloc >= 0 && xloc < MAP_SIZE && game.real_map[xloc].on_board)
-		scan(vmap, xloc);
-}
-
-/* Scan at distance 2 */
-for (i = 0; i < 8; i++) {
-	loc_t xloc = loc + 2 * dir_offset[i];
-	if (xloc >= 0 && xloc < MAP_SIZE && game.real_map[xloc].on_board)
-		scan(vmap, xloc);
-}
-
-scan(vmap, loc);
 }
 
 /*
@@ -628,7 +874,9 @@ city type.
 char city_char[] = {'*', '1', '2', '3', '4', 'C'};
 
 void update(view_map_t vmap[], loc_t loc) {
-	vmap[loc].seen = game.date;
+	char old_contents = vmap[loc].contents;
+
+	mark_seen(vmap, loc);
 
 	if (game.real_map[loc].cityp) /* is there a city here? */
 		vmap[loc].contents = city_char[game.real_map[loc].cityp->owner];
@@ -649,12 +897,121 @@ void update(view_map_t vmap[], loc_t loc) {
 		else
 			vmap[loc].contents = tolower(piece_attr[p->type].sname);
 	}
+	if (vmap[loc].contents != old_contents)
+		vmap_changed(loc);
 	if (vmap == game.comp_map)
 		display_locx(COMP, game.comp_map, loc);
 	else if (vmap == game.user_map)
 		display_locx(USER, game.user_map, loc);
 }
 
+/*
+Sight.  Every piece and city lets its owner watch the cells around
+it, and each view map counts the watchers of each cell.  A cell is
+brought up to date when it gains its first watcher and again whenever
+its real contents change while it is watched, so the view maps never
+need to be rescanned at the start of a turn.  A cell that loses its
+last watcher keeps what was last seen there.  The human players
+share one view map, and so share its counts.
+*/
+
+static void watch_cell(view_map_t vmap[], sight_t *sight, loc_t loc,
+                       int delta) {
+	if (delta > 0) {
+		if (sight[loc]++ == 0)
+			update(vmap, loc);
+	} else {
+		ASSERT(sight[loc] > 0);
+		if (--sight[loc] == 0)
+			mark_seen(vmap, loc);
+	}
+}
+
+/* Watch a cell and its neighbors, as 'scan' would look at them. */
+
+static void watch_around(view_map_t vmap[], loc_t loc, int delta) {
+	sight_t *sight;
+	int i;
+
+	sight = (vmap == game.comp_map) ? game.comp_sight : game.user_sight;
+	for (i = 0; i < 8; i++)
+		watch_cell(vmap, sight, loc + dir_offset[i], delta);
+	watch_cell(vmap, sight, loc, delta);
+}
+
+/*
+Add (delta 1) or take away (delta -1) the sight of a piece standing
+at a location.  A satellite also watches around each square one and
+two steps away from it in every direction.
+*/
+
+static void watch_piece(piece_info_t *obj, loc_t loc, int delta) {
+	view_map_t *vmap = MAP(obj->owner);
+	int i, j;
+
+	if (obj->type == SATELLITE) {
+		for (i = 0; i < 8; i++) {
+			for (j = 1; j <= 2; j++) {
+				loc_t xloc = loc + j * dir_offset[i];
+				if (xloc >= 0 && xloc < MAP_SIZE &&
+				    game.real_map[xloc].on_board)
+					watch_around(vmap, xloc, delta);
+			}
+		}
+	}
+	watch_around(vmap, loc, delta);
+}
+
+static void watch_city(city_info_t *cityp, int delta) {
+	if (cityp->owner != UNOWNED)
+		watch_around(MAP(cityp->owner), cityp->loc, delta);
+}
+
+/* Show a change in a cell to whoever is watching it. */
+
+static void show_cell(loc_t loc) {
+	if (game.user_sight[loc] > 0)
+		update(game.user_map, loc);
+	if (game.comp_sight[loc] > 0)
+		update(game.comp_map, loc);
+}
+
+/*
+Count the watchers afresh for a new or restored game.  Every watched
+cell is brought up to date as it is counted.
+*/
+
+void index_sight(void) {
+	count_t i;
+
+	(void)memset(game.comp_sight, 0, MAP_SIZE * sizeof(sight_t));
+	(void)memset(game.user_sight, 0, MAP_SIZE * sizeof(sight_t));
+	for (i = 0; i < NUM_CITY; i++)
+		watch_city(&game.city[i], 1);
+	for (i = 0; i < LIST_SIZE; i++) {
+		piece_info_t *obj = PIECE(i + 1);
+		if (obj->owner != UNOWNED && obj->hits > 0)
+			watch_piece(obj, obj->loc, 1);
+	}
+}
+
+/*
+Watched cells are not marked seen again each turn, since nothing new
+can be seen there.  Bring their dates up to today before they are
+saved.
+*/
+
+void date_sight(void) {
+	count_t i;
+
+	for (i = 0; i < MAP_SIZE; i++) {
+		if (game.comp_sight[i] > 0)
+			mark_seen(game.comp_map, i);
+		if (game.user_sight[i] > 0)
+			mark_seen(game.user_map, i);
+	}
+}
+
 /*
 Set the production for a city.  We make sure the city is displayed
 on the screen, and we ask the user for the new production.  We keep
@@ -369,16 +369,14 @@ void help(char **text, int nlines) {
 	(void)refresh();
 }
 
-#define COL_DIGITS                                                             \
-	((MAP_WIDTH <= 100) ? 2 : ((MAP_WIDTH <= 1000 ? 3 : (1 / 0))))
+#define COL_DIGITS ((MAP_WIDTH <= 100) ? 2 : 3) /* MAX_MAP_WIDTH < 1000 */
 
 int loc_disp(int loc) {
-	int row = loc / MAP_WIDTH;
+	int row = loc_row(loc);
 	int nrow = row;
-	int col = loc % MAP_WIDTH;
-	ASSERT(loc == (row * MAP_WIDTH) + col);
+	int col = loc_col(loc);
+	ASSERT(loc == row_col_loc(row, col));
 	int i;
-	// cppcheck-suppress zerodiv
 	for (i = COL_DIGITS; i > 0; i--) {
 		nrow *= 10;
 	}
@@ -8,6 +8,17 @@
 
 /*
 usermove.c -- Let the user move her troops.
+
+The human players share one view map, 'user_map', and it is kept up
+to date as pieces and cities watch cells (see 'watch_piece'), not
+rescanned at the start of each player's move.  So it also changes
+during the other players' turns.  A cell's seen date in 'user_seen' is
+set when the cell gains its first watcher, or when it is scanned.  It
+is not set again each turn the cell stays watched.  During play, the
+date of a cell watched for several turns is the turn the watching
+began, not the last turn it was viewed.  The dates of watched cells
+are brought up to today only when the game is saved (see
+'date_sight').
 */
 
 #include "empire.h"
@@ -23,6 +34,11 @@ void move_army_to_city(piece_info_t *obj, loc_t city_loc);
 bool awake(piece_info_t *obj);
 extern int get_piece_name(void);
 
+static path_ctx_t path_ctx; /* search scratch */
+/* Make room in our search context for the current map. */
+
+void size_user_maps(void) { size_path_ctx(&path_ctx); }
+
 void user_move(void) {
 	void piece_move(piece_info_t *);
 
@@ -30,62 +46,55 @@ void user_move(void) {
 	piece_info_t *obj, *next_obj;
 	int prod;
 
-	/* First we loop through objects to update the user's view
-	   of the world and perform any other necessary processing.
-	   We would like to have the world view up to date before
-	   asking the user any questions.  This means that we should
-	   also scan through all cities before possibly asking the
-	   user what to produce in each city. */
+	/* First we loop through objects to perform any necessary
+	   processing.  The user's view of the world is already up
+	   to date before we ask any questions, since it is kept
+	   current as pieces and cities come and go; see
+	   'watch_piece'. */
 
 	int current_owner = CURRENT_PLAYER();
 	
+	city_set_t *cs = &game.owned[current_owner];
+	piece_info_t **list = LIST(current_owner);
+
 	for (i = 0; i < NUM_OBJECTS; i++) {
-		for (obj = game.user_obj[i]; obj != NULL;
-		     obj = obj->piece_link.next) {
-			if (obj->owner == current_owner) {
-				obj->moved = 0; /* nothing moved yet */
-				scan(game.user_map,
-				     obj->loc); /* refresh user's view of world */
-			}
+		for (obj = list[i]; obj != NULL; obj = NEXT(obj, piece_link)) {
+			obj->moved = 0; /* nothing moved yet */
 		}
 	}
 
 	/* produce new hardware */
-	for (i = 0; i < NUM_CITY; i++) {
-		if (game.city[i].owner == current_owner) {
-			scan(game.user_map, game.city[i].loc);
-			prod = game.city[i].prod;
-
-			if (prod == NOPIECE) {
-				if (game.sim_mode) {
-					game.city[i].prod = ARMY;
-					game.city[i].work = 0;
-				} else {
-					set_prod(&(game.city[i]));
-				}
-			} else if (game.city[i].work++ >=
-			           (long)piece_attr[prod].build_time) {
-				/* kermyt begin */
-				ksend("%s has been completed at city %d.\n",
-				      piece_attr[prod].article,
-				      loc_disp(game.city[i].loc));
-				/* kermyt end */
-				comment("%s has been completed at city %d.\n",
-				        piece_attr[prod].article,
-				        loc_disp(game.city[i].loc));
-
-				produce(&game.city[i]);
-				/* produce should set object.moved to 0 */
+	for (j = 0; j < cs->count; j++) {
+		i = cs->index[j];
+		prod = game.city[i].prod;
+
+		if (prod == NOPIECE) {
+			if (game.sim_mode) {
+				game.city[i].prod = ARMY;
+				game.city[i].work = 0;
+			} else {
+				set_prod(&(game.city[i]));
 			}
+		} else if (game.city[i].work++ >=
+		           (long)piece_attr[prod].build_time) {
+			/* kermyt begin */
+			ksend("%s has been completed at city %d.\n",
+			      piece_attr[prod].article,
+			      loc_disp(game.city[i].loc));
+			/* kermyt end */
+			comment("%s has been completed at city %d.\n",
+			        piece_attr[prod].article,
+			        loc_disp(game.city[i].loc));
+
+			produce(&game.city[i]);
+			/* produce should set object.moved to 0 */
 		}
 	}
 
 	/* move all satellites */
-	for (obj = game.user_obj[SATELLITE]; obj != NULL; obj = next_obj) {
-		next_obj = obj->piece_link.next;
-		if (obj->owner == current_owner) {
-			move_sat(obj);
-		}
+	for (obj = list[SATELLITE]; obj != NULL; obj = next_obj) {
+		next_obj = NEXT(obj, piece_link);
+		move_sat(obj);
 	}
 
 	sec_start = cur_sector(); /* get currently displayed sector */
@@ -96,20 +105,16 @@ void user_move(void) {
 	/* loop through sectors, moving every piece in the sector */
 	for (i = sec_start; i < sec_start + NUM_SECTORS; i++) {
 		int sec = i % NUM_SECTORS;
+		piece_info_t **in_sec = game.sector_obj[current_owner][sec];
 		sector_change(); /* allow screen to be redrawn */
 
 		for (j = 0; j < NUM_OBJECTS; j++) { /* loop through obj lists */
-			for (obj = game.user_obj[move_order[j]]; obj != NULL;
+			for (obj = in_sec[move_order[j]]; obj != NULL;
 			     obj = next_obj) { /* loop through objs in list */
-				next_obj = obj->piece_link.next;
-
-				if (!obj->moved && obj->owner == current_owner) { /* object not moved yet? */
-					if (loc_sector(obj->loc) ==
-					    sec) { /* object in sector? */
-						piece_move(
-						    obj); /* yup; move the
-						             object */
-					}
+				next_obj = NEXT(obj, sector_link);
+
+				if (!obj->moved) { /* object not moved yet? */
+					piece_move(obj);
 				}
 			}
 		}
@@ -198,6 +203,7 @@ void piece_move(piece_info_t *obj) {
 			/* Armies and marines become entrenched on sentry */
 			if (obj->type == ARMY || obj->type == MARINE) {
 				obj->entrenched = true;
+				stack_changed(obj->loc); /* show it dug in */
 			}
 			obj->moved = speed;
 			break;
@@ -317,7 +323,7 @@ territory.
 */
 
 void move_explore(piece_info_t *obj) {
-	path_map_t path_map[MAP_SIZE];
+	path_map_t *path_map = path_ctx.path_map;
 	loc_t loc;
 	char *terrain;
 	move_info_t *army_info;
@@ -337,19 +343,19 @@ void move_explore(piece_info_t *obj) {
 	switch (obj->type) {
 	case ARMY:
 	case MARINE:
-		loc = vmap_find_lobj(path_map, game.user_map, obj->loc,
-		                     army_info);
+		loc = vmap_find_lobj(&path_ctx, path_map, game.user_map,
+		                     obj->loc, army_info, INFINITY);
 		terrain = "+";
 		break;
 	case FIGHTER:
 	case BOMBER:
-		loc = vmap_find_aobj(path_map, game.user_map, obj->loc,
-		                     &user_fighter);
+		loc = vmap_find_aobj(&path_ctx, path_map, game.user_map,
+		                     obj->loc, &user_fighter, obj->range);
 		terrain = "+.O";
 		break;
 	default:
-		loc = vmap_find_wobj(path_map, game.user_map, obj->loc,
-		                     &user_ship);
+		loc = vmap_find_wobj(&path_ctx, path_map, game.user_map,
+		                     obj->loc, &user_ship, INFINITY);
 		terrain = ".O";
 		break;
 	}
@@ -357,10 +363,11 @@ void move_explore(piece_info_t *obj) {
 	if (loc == obj->loc) {
 		return; /* nothing to explore */
 	}
-	if (game.user_map[loc].contents == ' ' && path_map[loc].cost == 2) {
+	if (game.user_map[loc].contents == ' ' &&
+	    PMAP_COST(path_map, loc) == 2) {
 		vmap_mark_adjacent(path_map, obj->loc);
 	} else {
-		vmap_mark_path(path_map, game.user_map, loc);
+		vmap_mark_path(&path_ctx, path_map, game.user_map, loc);
 	}
 
 	loc = vmap_find_dir(path_map, game.user_map, obj->loc, terrain, " ");
@@ -395,35 +402,35 @@ If there is an adjacent transport, move the army onto
 the transport, and awaken the army.
 */
 
-static view_map_t amap[MAP_SIZE];
-
 void move_armyload(piece_info_t *obj) {
+	view_map_t *amap = path_ctx.scratch;
 	loc_t loc;
 	piece_info_t *p;
 
 	ABORT;
 
 	/* look for an adjacent transport */
-	loc = find_transport(USER, obj->loc);
+	loc = find_transport(obj->owner, obj->loc);
 
 	if (loc != obj->loc) {
 		move_obj(obj, loc);
 		obj->func = NOFUNC;
 	} else { /* look for nearest non-full transport */
-		int i;
-		(void)memcpy(amap, game.user_map,
+		int i, k;
+		(void)memcpy(amap, MAP(obj->owner),
 		             sizeof(view_map_t) * MAP_SIZE);
 
 		/* mark loading transports or cities building transports */
-		for (p = game.user_obj[TRANSPORT]; p; p = p->piece_link.next) {
+		for (p = LIST(obj->owner)[TRANSPORT]; p;
+		     p = NEXT(p, piece_link)) {
 			if (p->count < obj_capacity(p)) { /* not full? */
 				amap[p->loc].contents = '$';
 			}
 		}
 
-		for (i = 0; i < NUM_CITY; i++) {
-			if (game.city[i].owner == USER &&
-			    game.city[i].prod == TRANSPORT) {
+		for (k = 0; k < game.owned[obj->owner].count; k++) {
+			i = game.owned[obj->owner].index[k];
+			if (game.city[i].prod == TRANSPORT) {
 				amap[game.city[i].loc].contents = '$';
 			}
 		}
@@ -435,7 +442,7 @@ Move an army toward an attackable city or enemy army.
 */
 
 void move_armyattack(piece_info_t *obj) {
-	path_map_t path_map[MAP_SIZE];
+	path_map_t *path_map = path_ctx.path_map;
 	loc_t loc;
 	move_info_t *attack_info;
 	view_map_t *player_map;
@@ -457,12 +464,13 @@ ASSERT(obj->type == ARMY || obj->type == MARINE);
 	player_map = MAP(owner);
 
 	/* Find target on continent using pathfinding */
-	loc = vmap_find_lobj(path_map, player_map, obj->loc, attack_info);
+	loc = vmap_find_lobj(&path_ctx, path_map, player_map, obj->loc,
+	                     attack_info, INFINITY);
 
 	if (loc == obj->loc) {
 		return; /* nothing to attack */
 	}
-	vmap_mark_path(path_map, player_map, loc);
+	vmap_mark_path(&path_ctx, path_map, player_map, loc);
 
 	loc = vmap_find_dir(path_map, player_map, obj->loc, "+", "X*a");
 	if (loc != obj->loc) {
@@ -477,7 +485,7 @@ Move a ship toward port.  If the ship is healthy, wake it up.
 */
 
 void move_repair(piece_info_t *obj) {
-	path_map_t path_map[MAP_SIZE];
+	path_map_t *path_map = path_ctx.path_map;
 	loc_t loc;
 
 	ASSERT(obj->type > FIGHTER);
@@ -492,13 +500,13 @@ void move_repair(piece_info_t *obj) {
 		return;
 	}
 
-	loc = vmap_find_wobj(path_map, game.user_map, obj->loc,
-	                     &user_ship_repair);
+	loc = vmap_find_wobj(&path_ctx, path_map, game.user_map, obj->loc,
+	                     &user_ship_repair, INFINITY);
 
 	if (loc == obj->loc) {
 		return; /* no reachable city */
 	}
-	vmap_mark_path(path_map, game.user_map, loc);
+	vmap_mark_path(&path_ctx, path_map, game.user_map, loc);
 
 	/* try to be next to ocean to avoid enemy pieces */
 	loc = vmap_find_dir(path_map, game.user_map, obj->loc, ".O", ".");
@@ -533,9 +541,9 @@ void move_land(piece_info_t *obj) {
 	loc_t best_loc;
 	piece_info_t *p;
 
-	best_dist = find_nearest_city(obj->loc, USER, &best_loc);
+	best_dist = find_nearest_city(obj->loc, obj->owner, &best_loc);
 
-	for (p = game.user_obj[CARRIER]; p != NULL; p = p->piece_link.next) {
+	for (p = LIST(obj->owner)[CARRIER]; p; p = NEXT(p, piece_link)) {
 		long new_dist = dist(obj->loc, p->loc);
 		if (new_dist < best_dist) {
 			best_dist = new_dist;
@@ -592,10 +600,16 @@ Move a piece toward a specific destination.  We first map out
 the paths to the destination, if we can't get there, we return.
 Then we mark the paths to the destination.  Then we choose a
 move.
+
+Pieces headed for the same destination share a flow field, so
+normally we just read our move from that.  A far destination is
+routed over clusters instead, which only searches as far as the next
+cluster on the route.  When tracing path maps we build the path map
+the long way so that it can be shown.
 */
 
 void move_to_dest(piece_info_t *obj, loc_t dest) {
-	path_map_t path_map[MAP_SIZE];
+	path_map_t *path_map = path_ctx.path_map;
 	int fterrain;
 	char *mterrain;
 	loc_t new_loc;
@@ -617,16 +631,22 @@ void move_to_dest(piece_info_t *obj, loc_t dest) {
 		break;
 	}
 
-	new_loc = vmap_find_dest(path_map, game.user_map, obj->loc, dest, USER,
-	                         fterrain);
-	if (new_loc == obj->loc) {
-		return; /* can't get there */
+	if (game.trace_pmap || vmap_route_far(obj->loc, dest, fterrain)) {
+		new_loc = vmap_find_dest(&path_ctx, path_map, game.user_map,
+		                         obj->loc, dest, USER, fterrain);
+		if (new_loc == obj->loc) {
+			return; /* can't get there */
+		}
+		vmap_mark_path(&path_ctx, path_map, game.user_map, new_loc);
+		new_loc = vmap_find_dir(path_map, game.user_map, obj->loc,
+		                        mterrain, " .");
+	} else {
+		new_loc = vmap_find_flow_dir(&path_ctx, game.user_map, obj->loc,
+		                             dest, USER, fterrain, mterrain,
+		                             " .");
 	}
-	vmap_mark_path(path_map, game.user_map, dest);
-	new_loc =
-	    vmap_find_dir(path_map, game.user_map, obj->loc, mterrain, " .");
 	if (new_loc == obj->loc) {
-		return; /* can't move ahead */
+		return; /* can't get there or can't move ahead */
 	}
 	ASSERT(good_loc(obj, new_loc));
 	move_obj(obj, new_loc); /* everything looks good */
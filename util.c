@@ -17,6 +17,7 @@ util.c -- various utility routines.
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -55,6 +56,40 @@ size_t buf_append(char **cursor, size_t *remaining, const char *fmt, ...) {
 	return rem;
 }
 
+/*
+Give an array room for 'count' elements of 'size' bytes, all zero.
+Whatever the array held is thrown away.  We give up the game if there
+is no memory to be had.
+*/
+
+void *resize_array(void *array, size_t count, size_t size) {
+	free(array);
+	array = calloc(count > 0 ? count : 1, size);
+	if (array == NULL) {
+		(void)fprintf(stderr, "empire: out of memory.\n");
+		exit(1);
+	}
+	return array;
+}
+
+/*
+Give an array of 'old_count' elements room for 'count', keeping what
+it held and zeroing the rest.
+*/
+
+void *grow_array(void *array, size_t old_count, size_t count, size_t size) {
+	array = realloc(array, (count > 0 ? count : 1) * size);
+	if (array == NULL) {
+		(void)fprintf(stderr, "empire: out of memory.\n");
+		exit(1);
+	}
+	if (count > old_count) {
+		(void)memset((char *)array + old_count * size, 0,
+		             (count - old_count) * size);
+	}
+	return array;
+}
+
 /*
 Report a bug.
 */
@@ -101,45 +136,69 @@ and an appropriate owner.
 3)  Make sure every city is on the map.
 
 4)  Make sure every object is in the correct location and that
-objects on the map have non-zero hits.
+objects on the map have non-zero hits, and that each cell shows the
+right object.
 
 5)  Make sure every object in a cargo list has a ship pointer.
 
 6)  Make sure every object with a ship pointer is in that ship's
 cargo list.
+
+7)  Make sure every city is in its owner's city set, in order.
+
+8)  Make sure every object on the map is in the sector list for its
+owner, sector and type.
+
+9)  Make sure each view cell's count of watchers matches the pieces
+and cities around it.
 */
 
-static bool in_free[LIST_SIZE];  /* true if object in free list */
-static bool in_obj[LIST_SIZE];   /* true if object in obj list */
-static bool in_loc[LIST_SIZE];   /* true if object in a loc list */
-static bool in_cargo[LIST_SIZE]; /* true if object in a cargo list */
+static bool *in_free;   /* true if object in free list */
+static bool *in_obj;    /* true if object in obj list */
+static bool *in_loc;    /* true if object in a loc list */
+static bool *in_cargo;  /* true if object in a cargo list */
+static bool *in_sector; /* true if object in a sector list */
+static long in_size;    /* objects the above have room for */
 
 void check(void) {
 	void check_cargo(piece_info_t *, int);
 	void check_obj(piece_info_t **, int);
 	void check_obj_cargo(piece_info_t **);
+	void check_sector(int, int);
+	void check_sight(void);
 
 	long i, j;
 	piece_info_t *p;
 
+	if (in_size != LIST_SIZE) { /* the pool has grown */
+		in_size = LIST_SIZE;
+		RESIZE(in_free, in_size);
+		RESIZE(in_obj, in_size);
+		RESIZE(in_loc, in_size);
+		RESIZE(in_cargo, in_size);
+		RESIZE(in_sector, in_size);
+	}
+
 	/* nothing in any list yet */
 	for (i = 0; i < LIST_SIZE; i++) {
 		in_free[i] = 0;
 		in_obj[i] = 0;
 		in_loc[i] = 0;
 		in_cargo[i] = 0;
+		in_sector[i] = 0;
 	}
 
 	/* Mark all objects in free list.  Make sure objects in free list
 	   have zero hits. */
 
-	for (p = game.free_list; p != NULL; p = p->piece_link.next) {
-		i = p - game.object;
+	for (p = game.free_list; p != NULL; p = NEXT(p, piece_link)) {
+		i = PIECE_ID(p) - 1;
 		ASSERT(!in_free[i]);
 		in_free[i] = 1;
 		ASSERT(p->hits == 0);
 		if (p->piece_link.prev) {
-			ASSERT(p->piece_link.prev->piece_link.next == p);
+			ASSERT(PREV(p, piece_link)->piece_link.next ==
+			       PIECE_ID(p));
 		}
 	}
 
@@ -154,50 +213,75 @@ void check(void) {
 		}
 
 		for (p = game.real_map[i].objp; p != NULL;
-		     p = p->loc_link.next) {
+		     p = NEXT(p, loc_link)) {
 			ASSERT(p->loc == i);
 			ASSERT(p->hits > 0);
 			ASSERT(p->owner == USER || p->owner == COMP || p->owner == USER2 || p->owner == USER3 || p->owner == USER4);
 
-			j = p - game.object;
+			j = PIECE_ID(p) - 1;
 			ASSERT(!in_loc[j]);
 			in_loc[j] = 1;
 
 			if (p->loc_link.prev) {
-				ASSERT(p->loc_link.prev->loc_link.next == p);
+				ASSERT(PREV(p, loc_link)->loc_link.next ==
+				       PIECE_ID(p));
 			}
 		}
+
+		p = game.real_map[i].top; /* is the cached choice current? */
+		stack_changed(i);
+		ASSERT(game.real_map[i].top == p);
 	}
 
-	/* make sure all cities are on map */
+	/* make sure all cities are on map and in their owner's set */
 
 	for (i = 0; i < NUM_CITY; i++) {
 		ASSERT(game.real_map[game.city[i].loc].cityp ==
 		       &(game.city[i]));
 	}
+	j = 0;
+	for (i = 0; i < NUM_OWNERS; i++) {
+		city_set_t *cs = &game.owned[i];
+		long k;
+
+		for (k = 0; k < cs->count; k++) {
+			ASSERT(game.city[cs->index[k]].owner == i);
+			ASSERT(k == 0 || cs->index[k - 1] < cs->index[k]);
+		}
+		j += cs->count;
+	}
+	ASSERT(j == NUM_CITY);
 
-	/* Scan object lists. */
+	/* Scan object and cargo lists. */
 
-	check_obj(game.comp_obj, COMP);
-	check_obj(game.user_obj, USER);
+	for (i = USER; i <= COMP; i++) {
+		check_obj(LIST(i), i);
+		check_cargo(LIST(i)[TRANSPORT], ARMY);
+		check_cargo(LIST(i)[CARRIER], FIGHTER);
+	}
 
-	/* Scan cargo lists. */
+	/* Make sure all objects with ship pointers are in cargo. */
 
-	check_cargo(game.user_obj[TRANSPORT], ARMY);
-	check_cargo(game.comp_obj[TRANSPORT], ARMY);
-	check_cargo(game.user_obj[CARRIER], FIGHTER);
-	check_cargo(game.comp_obj[CARRIER], FIGHTER);
+	for (i = USER; i <= COMP; i++) {
+		check_obj_cargo(LIST(i));
+	}
 
-	/* Make sure all objects with ship pointers are in cargo. */
+	/* Scan sector lists. */
 
-	check_obj_cargo(game.comp_obj);
-	check_obj_cargo(game.user_obj);
+	for (i = USER; i <= COMP; i++) {
+		for (j = 0; j < NUM_SECTORS; j++) {
+			check_sector(i, j);
+		}
+	}
 
 	/* Make sure every object is either free or in loc and obj list. */
 
 	for (i = 0; i < LIST_SIZE; i++) {
 		ASSERT(in_free[i] != (in_loc[i] && in_obj[i]));
+		ASSERT(in_sector[i] == in_loc[i]);
 	}
+
+	check_sight();
 }
 
 /*
@@ -218,18 +302,18 @@ void check_obj(piece_info_t **list, int owner) {
 	piece_info_t *p;
 
 	for (i = 0; i < NUM_OBJECTS; i++) {
-		for (p = list[i]; p != NULL; p = p->piece_link.next) {
+		for (p = list[i]; p != NULL; p = NEXT(p, piece_link)) {
 			ASSERT(p->owner == owner);
 			ASSERT(p->type == i);
 			ASSERT(p->hits > 0);
 
-			j = p - game.object;
+			j = PIECE_ID(p) - 1;
 			ASSERT(!in_obj[j]);
 			in_obj[j] = 1;
 
 			if (p->piece_link.prev) {
-				ASSERT(p->piece_link.prev->piece_link.next ==
-				       p);
+				ASSERT(PREV(p, piece_link)->piece_link.next ==
+				       PIECE_ID(p));
 			}
 		}
 	}
@@ -259,23 +343,23 @@ void check_cargo(piece_info_t *list, int cargo_type) {
 	piece_info_t *p, *q;
 	long j;
 
-	for (p = list; p != NULL; p = p->piece_link.next) {
+	for (p = list; p != NULL; p = NEXT(p, piece_link)) {
 		long count = 0;
-		for (q = p->cargo; q != NULL; q = q->cargo_link.next) {
+		for (q = p->cargo; q != NULL; q = NEXT(q, cargo_link)) {
 			count += 1; /* count items in list */
 			ASSERT(q->type == cargo_type);
 			ASSERT(q->owner == p->owner);
 			ASSERT(q->hits > 0);
-			ASSERT(q->ship == p);
+			ASSERT(SHIP(q) == p);
 			ASSERT(q->loc == p->loc);
 
-			j = q - game.object;
+			j = PIECE_ID(q) - 1;
 			ASSERT(!in_cargo[j]);
 			in_cargo[j] = 1;
 
-			if (p->cargo_link.prev) {
-				ASSERT(p->cargo_link.prev->cargo_link.next ==
-				       p);
+			if (q->cargo_link.prev) {
+				ASSERT(PREV(q, cargo_link)->cargo_link.next ==
+				       PIECE_ID(q));
 			}
 		}
 		ASSERT(count == p->count);
@@ -294,12 +378,112 @@ void check_obj_cargo(piece_info_t **list) {
 	long i;
 
 	for (i = 0; i < NUM_OBJECTS; i++) {
-		for (p = list[i]; p != NULL; p = p->piece_link.next) {
+		for (p = list[i]; p != NULL; p = NEXT(p, piece_link)) {
 			if (p->ship) {
-				ASSERT(in_cargo[p - game.object]);
+				ASSERT(in_cargo[PIECE_ID(p) - 1]);
 			}
 		}
 	}
 }
 
+/*
+Check the sector lists of one owner and sector.  Every object must be
+alive and belong there, the lists must have no loops and good prev
+ptrs, and each list must be in the order of the piece list.
+*/
+
+void check_sector(int owner, int sector) {
+	piece_info_t **list = game.sector_obj[owner][sector];
+	piece_info_t *p, *q;
+	long i, j;
+
+	for (i = 0; i < NUM_OBJECTS; i++) {
+		for (p = list[i]; p != NULL; p = NEXT(p, sector_link)) {
+			ASSERT(p->owner == owner);
+			ASSERT(p->type == i);
+			ASSERT(p->hits > 0);
+			ASSERT(loc_sector(p->loc) == sector);
+
+			j = PIECE_ID(p) - 1;
+			ASSERT(!in_sector[j]);
+			in_sector[j] = 1;
+
+			if (p->sector_link.prev) {
+				ASSERT(PREV(p, sector_link)->sector_link.next ==
+				       PIECE_ID(p));
+			}
+			q = NEXT(p, piece_link);
+			while (q != NULL &&
+			       PIECE_ID(q) != p->sector_link.next) {
+				q = NEXT(q, piece_link);
+			}
+			ASSERT(q != NULL || p->sector_link.next == 0);
+		}
+	}
+}
+
+/*
+Count again the pieces and cities watching each view cell, the way
+'watch_piece' and 'watch_city' do, and compare with the counts kept.
+*/
+
+static sight_t *want_comp; /* watchers found per cell */
+static sight_t *want_user;
+static long want_size;     /* cells the above have room for */
+
+static void want_around(sight_t *want, long loc) {
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		want[loc + dir_offset[i]] += 1;
+	}
+	want[loc] += 1;
+}
+
+void check_sight(void) {
+	sight_t *want;
+	long i, j, k;
+
+	if (want_size != MAP_SIZE) {
+		want_size = MAP_SIZE;
+		RESIZE(want_comp, want_size);
+		RESIZE(want_user, want_size);
+	}
+	for (i = 0; i < MAP_SIZE; i++) {
+		want_comp[i] = 0;
+		want_user[i] = 0;
+	}
+	for (i = 0; i < NUM_CITY; i++) {
+		if (game.city[i].owner != UNOWNED) {
+			want = (game.city[i].owner == COMP) ? want_comp
+			                                    : want_user;
+			want_around(want, game.city[i].loc);
+		}
+	}
+	for (i = 0; i < LIST_SIZE; i++) {
+		piece_info_t *p = PIECE(i + 1);
+		if (p->owner == UNOWNED || p->hits == 0) {
+			continue;
+		}
+		want = (p->owner == COMP) ? want_comp : want_user;
+		want_around(want, p->loc);
+		if (p->type != SATELLITE) {
+			continue;
+		}
+		for (j = 0; j < 8; j++) {
+			for (k = 1; k <= 2; k++) {
+				long xloc = p->loc + k * dir_offset[j];
+				if (xloc >= 0 && xloc < MAP_SIZE &&
+				    game.real_map[xloc].on_board) {
+					want_around(want, xloc);
+				}
+			}
+		}
+	}
+	for (i = 0; i < MAP_SIZE; i++) {
+		ASSERT(want_comp[i] == game.comp_sight[i]);
+		ASSERT(want_user[i] == game.user_sight[i]);
+	}
+}
+
 /* end */